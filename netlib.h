@@ -23,14 +23,587 @@ E-MAIL: garbaz@t-online.de
 GIT: https://github.com/garbaz/netlib
 */
 
+/* Several wrappers use Linux specific calls (accept4, sendmmsg, splice, ...), so include this header before any system header. */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <limits.h>
+#include <stddef.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <linux/filter.h>
+#include <linux/errqueue.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 
 
+/*
+DNS cache:
+	All functions resolving addresses go through a process wide, thread safe cache of getaddrinfo results,
+	keyed by host, port, socket type and flags. The one exception is usock, which hands out its own getaddrinfo
+	list to be freed with freeaddrinfo, usock_cached is its cached counterpart. Successful lookups are kept for DNS_CACHE_TTL_MS,
+	failed lookups for DNS_CACHE_NEG_TTL_MS (both adjustable with dns_set_ttl). At most DNS_CACHE_MAX_ENTRIES lookups
+	are kept, once full, expired entries and then the oldest entries of each bucket make room.
+	Results handed out by dns_lookup are reference counted and stay valid until dns_release, even if the
+	entry is flushed or expires in the meantime.
+*/
+
+#define DNS_CACHE_BUCKETS (256)
+#define DNS_CACHE_TTL_MS (60000)
+#define DNS_CACHE_NEG_TTL_MS (5000)
+#define DNS_CACHE_MAX_ENTRIES (1024)
+
+struct dns_entry
+{
+	struct dns_entry *next;
+	const char *host;
+	const char *port;
+	int socktype;
+	int flags;
+	int64_t expires_ms;
+	int refs;
+	int cached;
+	int count;
+	struct addrinfo ai[];
+};
+
+static struct
+{
+	pthread_mutex_t lock;
+	struct dns_entry *buckets[DNS_CACHE_BUCKETS];
+	int ttl_ms;
+	int neg_ttl_ms;
+	int count;
+	int evict;
+} dns_cache = { PTHREAD_MUTEX_INITIALIZER, { NULL }, DNS_CACHE_TTL_MS, DNS_CACHE_NEG_TTL_MS, 0, 0 };
+
+static int64_t netlib__now_ms(void)
+{
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static unsigned int dns__hash(const char* host, const char* port, int socktype, int flags)
+{
+	unsigned int h = 2166136261u;
+	
+	while(*host) h = (h ^ (unsigned char)*host++) * 16777619u;
+	h = (h ^ ':') * 16777619u;
+	while(*port) h = (h ^ (unsigned char)*port++) * 16777619u;
+	h = (h ^ (unsigned int)socktype) * 16777619u;
+	h = (h ^ (unsigned int)flags) * 16777619u;
+	return h % DNS_CACHE_BUCKETS;
+}
+
+/* Copies a resolved address list (or a failure if [res] is NULL) into a single allocation */
+static struct dns_entry *dns__entry_create(const char* host, const char* port, int socktype, int flags, struct addrinfo *res)
+{
+	struct dns_entry *e;
+	struct addrinfo *cur;
+	struct sockaddr_storage *addrs;
+	char *strings;
+	size_t host_size = strlen(host) + 1, port_size = strlen(port) + 1;
+	int count = 0, i;
+	
+	for(cur = res; cur != NULL; cur = cur->ai_next) count++;
+	e = (struct dns_entry*)malloc(sizeof *e + count * (sizeof(struct addrinfo) + sizeof(struct sockaddr_storage)) + host_size + port_size);
+	if(e == NULL)
+	{
+		return NULL;
+	}
+	addrs = (struct sockaddr_storage*)(e->ai + count);
+	strings = (char*)(addrs + count);
+	
+	for(cur = res, i = 0; cur != NULL; cur = cur->ai_next, i++)
+	{
+		e->ai[i] = *cur;
+		memcpy(&addrs[i], cur->ai_addr, cur->ai_addrlen);
+		e->ai[i].ai_addr = (struct sockaddr*)&addrs[i];
+		e->ai[i].ai_canonname = NULL;
+		e->ai[i].ai_next = (i + 1 < count) ? &e->ai[i + 1] : NULL;
+	}
+	memcpy(strings, host, host_size);
+	memcpy(strings + host_size, port, port_size);
+	e->host = strings;
+	e->port = strings + host_size;
+	e->socktype = socktype;
+	e->flags = flags;
+	e->count = count;
+	e->refs = 0;
+	e->cached = 0;
+	e->next = NULL;
+	return e;
+}
+
+/* Takes [e] out of the cache (lock held). It is freed once the last reference is released. */
+static void dns__unlink(struct dns_entry **link)
+{
+	struct dns_entry *e = *link;
+	
+	*link = e->next;
+	e->cached = 0;
+	dns_cache.count--;
+	if(e->refs == 0) free(e);
+}
+
+/* Makes room for one more entry (lock held): drops expired entries, then the oldest entry of bucket after bucket */
+static void dns__shrink(int64_t now)
+{
+	struct dns_entry **link;
+	int i;
+	
+	if(dns_cache.count < DNS_CACHE_MAX_ENTRIES) return;
+	for(i = 0; i < DNS_CACHE_BUCKETS; i++)
+	{
+		for(link = &dns_cache.buckets[i]; *link != NULL; )
+		{
+			if((*link)->expires_ms <= now)
+			{
+				dns__unlink(link);
+				continue;
+			}
+			link = &(*link)->next;
+		}
+	}
+	while(dns_cache.count >= DNS_CACHE_MAX_ENTRIES)
+	{
+		// New entries are put in front, so the last one of a bucket is its oldest
+		for(link = &dns_cache.buckets[dns_cache.evict]; *link != NULL && (*link)->next != NULL; link = &(*link)->next);
+		if(*link != NULL) dns__unlink(link);
+		dns_cache.evict = (dns_cache.evict + 1) % DNS_CACHE_BUCKETS;
+	}
+}
+
+
+#define DNS_NUMERIC_ERRS (1)
+#define DNS_NUMERIC_ERR_NOTNUM (-1)
+#define DNS_NUMERIC_ERR_NOTNUM_STR "Not a numeric address"
+
+#define DNS_NUMERIC_ERR__STR(err) ((err == DNS_NUMERIC_ERR_NOTNUM) ? DNS_NUMERIC_ERR_NOTNUM_STR : "")
+
+/**
+ * Fills a socket address directly from an IPv4 / IPv6 literal and a numeric port, without the resolver and without allocating.
+ * 
+ * const char* host:              IP address (e.g. "10.0.3.17", "::1")
+ * const char* port:              Numeric port (e.g. "80", "1729")
+ * struct sockaddr_storage *addr: Struct in which the address will be saved
+ * socklen_t *addr_size:          Will be set to the size of the address saved in [addr]
+ * 
+ * return:                        Returns 0 upon success and error code if [host] or [port] are not numeric
+ * 
+ * {error codes}:
+ *  Not a numeric address => -1
+ */
+int dns_numeric(const char* host, const char* port, struct sockaddr_storage *addr, socklen_t *addr_size)
+{
+	unsigned int portnum = 0;
+	const char *c;
+	
+	if(host == NULL || port == NULL || *port == '\0')
+	{
+		return -1;
+	}
+	for(c = port; *c != '\0'; c++)
+	{
+		if(*c < '0' || *c > '9' || c - port > 4) return -1;
+		portnum = portnum * 10 + (unsigned int)(*c - '0');
+	}
+	if(portnum > 65535)
+	{
+		return -1;
+	}
+	
+	memset(addr, 0, sizeof *addr);
+	if(inet_pton(AF_INET, host, &((struct sockaddr_in*)addr)->sin_addr) == 1)
+	{
+		((struct sockaddr_in*)addr)->sin_family = AF_INET;
+		((struct sockaddr_in*)addr)->sin_port = htons((unsigned short)portnum);
+		*addr_size = sizeof(struct sockaddr_in);
+		return 0;
+	}
+	if(inet_pton(AF_INET6, host, &((struct sockaddr_in6*)addr)->sin6_addr) == 1)
+	{
+		((struct sockaddr_in6*)addr)->sin6_family = AF_INET6;
+		((struct sockaddr_in6*)addr)->sin6_port = htons((unsigned short)portnum);
+		*addr_size = sizeof(struct sockaddr_in6);
+		return 0;
+	}
+	return -1;
+}
+
+#define DNS_LOOKUP_ERRS (2)
+#define DNS_LOOKUP_ERR_ADDR (-1)
+#define DNS_LOOKUP_ERR_ADDR_STR "Unable to resolve address"
+#define DNS_LOOKUP_ERR_MEM (-2)
+#define DNS_LOOKUP_ERR_MEM_STR "Unable to allocate memory"
+
+#define DNS_LOOKUP_ERR__STR(err) ((err == DNS_LOOKUP_ERR_ADDR) ? DNS_LOOKUP_ERR_ADDR_STR : (err == DNS_LOOKUP_ERR_MEM) ? DNS_LOOKUP_ERR_MEM_STR : "")
+
+/**
+ * Resolves an address through the DNS cache (getaddrinfo is only called on a miss).
+ * 
+ * const char* host:       IP or web address to resolve (NULL for the wildcard address used by hosts)
+ * const char* port:       Port to resolve (e.g. "80", "1729", NULL for none)
+ * int socktype:           SOCK_STREAM or SOCK_DGRAM
+ * int flags:              getaddrinfo flags (e.g. AI_PASSIVE)
+ * struct addrinfo **info: Will be set to the resolved address list. Release it with dns_release (not freeaddrinfo)!
+ * 
+ * return:                 Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to resolve address => -1
+ *  Unable to allocate memory => -2
+ */
+int dns_lookup(const char* host, const char* port, int socktype, int flags, struct addrinfo **info)
+{
+	struct dns_entry **link, *e;
+	struct addrinfo hints, *res = NULL;
+	struct sockaddr_storage numeric_addr;
+	socklen_t numeric_addr_size;
+	const char *key_host = host ? host : "";
+	const char *key_port = port ? port : "";
+	unsigned int bucket = dns__hash(key_host, key_port, socktype, flags);
+	int64_t now = netlib__now_ms();
+	int ret;
+	
+	pthread_mutex_lock(&dns_cache.lock);
+	for(link = &dns_cache.buckets[bucket]; (e = *link) != NULL; )
+	{
+		if(e->expires_ms <= now)
+		{
+			dns__unlink(link);
+			continue;
+		}
+		if(e->socktype == socktype && e->flags == flags && strcmp(e->host, key_host) == 0 && strcmp(e->port, key_port) == 0)
+		{
+			if(e->count == 0)
+			{
+				pthread_mutex_unlock(&dns_cache.lock);
+				return -1;
+			}
+			e->refs++;
+			*info = e->ai;
+			pthread_mutex_unlock(&dns_cache.lock);
+			return 0;
+		}
+		link = &e->next;
+	}
+	pthread_mutex_unlock(&dns_cache.lock);
+	
+	// Miss: resolve without holding the lock, literals need no resolver at all
+	if(dns_numeric(host, port, &numeric_addr, &numeric_addr_size) == 0)
+	{
+		memset(&hints, 0, sizeof hints);
+		hints.ai_family = numeric_addr.ss_family;
+		hints.ai_socktype = socktype;
+		hints.ai_protocol = (socktype == SOCK_STREAM) ? IPPROTO_TCP : (socktype == SOCK_DGRAM) ? IPPROTO_UDP : 0;
+		hints.ai_addr = (struct sockaddr*)&numeric_addr;
+		hints.ai_addrlen = numeric_addr_size;
+		e = dns__entry_create(key_host, key_port, socktype, flags, &hints);
+	}
+	else
+	{
+		memset(&hints, 0, sizeof hints);
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = socktype;
+		hints.ai_flags = flags;
+		ret = getaddrinfo(host, port, &hints, &res);
+		if(ret == EAI_AGAIN || ret == EAI_MEMORY || ret == EAI_SYSTEM)
+		{
+			// Transient failures are not worth caching
+			return -1;
+		}
+		e = dns__entry_create(key_host, key_port, socktype, flags, (ret == 0) ? res : NULL);
+		if(ret == 0) freeaddrinfo(res);
+	}
+	if(e == NULL)
+	{
+		return -2;
+	}
+	
+	pthread_mutex_lock(&dns_cache.lock);
+	e->expires_ms = now + ((e->count > 0) ? dns_cache.ttl_ms : dns_cache.neg_ttl_ms);
+	for(link = &dns_cache.buckets[bucket]; *link != NULL; )
+	{
+		// Another thread might have resolved the same key meanwhile
+		if((*link)->socktype == socktype && (*link)->flags == flags && strcmp((*link)->host, key_host) == 0 && strcmp((*link)->port, key_port) == 0)
+		{
+			dns__unlink(link);
+			continue;
+		}
+		link = &(*link)->next;
+	}
+	dns__shrink(now);
+	e->next = dns_cache.buckets[bucket];
+	e->cached = 1;
+	dns_cache.buckets[bucket] = e;
+	dns_cache.count++;
+	if(e->count == 0)
+	{
+		pthread_mutex_unlock(&dns_cache.lock);
+		return -1;
+	}
+	e->refs++;
+	*info = e->ai;
+	pthread_mutex_unlock(&dns_cache.lock);
+	return 0;
+}
+
+#define DNS_RELEASE_ERRS (0)
+#define DNS_RELEASE_ERR__STR(err) ""
+
+/**
+ * Releases an address list handed out by dns_lookup (or usock_cached).
+ * 
+ */
+void dns_release(struct addrinfo *info)
+{
+	struct dns_entry *e;
+	
+	if(info == NULL) return;
+	e = (struct dns_entry*)((char*)info - offsetof(struct dns_entry, ai));
+	pthread_mutex_lock(&dns_cache.lock);
+	if(--e->refs == 0 && !e->cached) free(e);
+	pthread_mutex_unlock(&dns_cache.lock);
+}
+
+#define DNS_FLUSH_ERRS (0)
+#define DNS_FLUSH_ERR__STR(err) ""
+
+/**
+ * Drops cached lookups, so the next lookup asks the resolver again.
+ * 
+ * const char* host: Only drop lookups of this host (NULL to drop everything)
+ */
+void dns_flush(const char* host)
+{
+	struct dns_entry **link;
+	int i;
+	
+	pthread_mutex_lock(&dns_cache.lock);
+	for(i = 0; i < DNS_CACHE_BUCKETS; i++)
+	{
+		for(link = &dns_cache.buckets[i]; *link != NULL; )
+		{
+			if(host == NULL || strcmp((*link)->host, host) == 0)
+			{
+				dns__unlink(link);
+				continue;
+			}
+			link = &(*link)->next;
+		}
+	}
+	pthread_mutex_unlock(&dns_cache.lock);
+}
+
+#define DNS_SET_TTL_ERRS (0)
+#define DNS_SET_TTL_ERR__STR(err) ""
+
+/**
+ * Sets how long lookups are cached. Applies to lookups resolved afterwards.
+ * 
+ * int ttl_ms:     Time successful lookups are kept in milliseconds (0 disables caching)
+ * int neg_ttl_ms: Time failed lookups are kept in milliseconds (0 disables negative caching)
+ */
+void dns_set_ttl(int ttl_ms, int neg_ttl_ms)
+{
+	pthread_mutex_lock(&dns_cache.lock);
+	dns_cache.ttl_ms = ttl_ms;
+	dns_cache.neg_ttl_ms = neg_ttl_ms;
+	pthread_mutex_unlock(&dns_cache.lock);
+}
+
+
+#define SET_NONBLOCK_ERRS (1)
+#define SET_NONBLOCK_ERR_FCNTL (-1)
+#define SET_NONBLOCK_ERR_FCNTL_STR "Unable to change file descriptor flags"
+
+#define SET_NONBLOCK_ERR__STR(err) ((err == SET_NONBLOCK_ERR_FCNTL) ? SET_NONBLOCK_ERR_FCNTL_STR : "")
+
+/**
+ * Switches a UNIX file descriptor into (or out of) non-blocking mode.
+ * File descriptors registered edge-triggered with the reactor should be non-blocking.
+ * 
+ * int fd:     UNIX file descriptor to change
+ * int enable: 1 to enable non-blocking mode, 0 to disable it
+ * 
+ * return:     Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to change file descriptor flags => -1
+ */
+int set_nonblock(int fd, int enable)
+{
+	int flags;
+	
+	if((flags = fcntl(fd, F_GETFL, 0)) == -1)
+	{
+		return -1;
+	}
+	flags = enable ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+	if(fcntl(fd, F_SETFL, flags) == -1)
+	{
+		return -1;
+	}
+	return 0;
+}
+
+#define TCONNECT_MAX_ATTEMPTS (16)
+#define TCONNECT_STAGGER_MS (250)
+
+static int tconnect__start(const struct addrinfo *ai, struct pollfd *attempt)
+{
+	int fd;
+	
+	if((fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK, ai->ai_protocol)) == -1)
+	{
+		return -2;
+	}
+	if(connect(fd, ai->ai_addr, ai->ai_addrlen) == -1 && errno != EINPROGRESS)
+	{
+		close(fd);
+		return -3;
+	}
+	attempt->fd = fd;
+	attempt->events = POLLOUT;
+	attempt->revents = 0;
+	return 0;
+}
+
+/*
+Races connection attempts to all addresses of [servinfo] (RFC 8305 "Happy Eyeballs"):
+Addresses are reordered to alternate between address families, starting with the family the resolver preferred.
+A new attempt is started every TCONNECT_STAGGER_MS or as soon as an attempt failed. The first connected socket
+is switched back to blocking mode and returned, all other attempts are closed.
+Returns the file descriptor, -2 if no socket could be set up, -3 if no attempt connected or -4 once [timeout_ms] (-1 for none) passed.
+*/
+static int tconnect__race(struct addrinfo *servinfo, int timeout_ms)
+{
+	const struct addrinfo *order[TCONNECT_MAX_ATTEMPTS];
+	struct pollfd attempts[TCONNECT_MAX_ATTEMPTS];
+	const struct addrinfo *cur;
+	int count = 0, next = 0, active = 0, sock_failed = 0;
+	int first_family = servinfo->ai_family;
+	int64_t now = netlib__now_ms();
+	int64_t deadline = (timeout_ms < 0) ? -1 : now + timeout_ms;
+	int64_t next_start = now;
+	int i, j;
+	
+	// Interleave families: preferred family first, then alternate with the others
+	for(i = 0; count < TCONNECT_MAX_ATTEMPTS; i++)
+	{
+		int want_first = (i % 2 == 0), taken = 0, skip = i / 2;
+		
+		for(cur = servinfo; cur != NULL; cur = cur->ai_next)
+		{
+			if((cur->ai_family == first_family) != want_first) continue;
+			if(skip-- > 0) continue;
+			order[count++] = cur;
+			taken = 1;
+			break;
+		}
+		if(!taken)
+		{
+			// One family ran out, append the rest of the other one
+			for(cur = servinfo; cur != NULL && count < TCONNECT_MAX_ATTEMPTS; cur = cur->ai_next)
+			{
+				for(j = 0; j < count && order[j] != cur; j++);
+				if(j == count) order[count++] = cur;
+			}
+			break;
+		}
+	}
+	
+	for(;;)
+	{
+		int wait_ms, ready;
+		
+		now = netlib__now_ms();
+		while(next < count && (active == 0 || now >= next_start))
+		{
+			int ret = tconnect__start(order[next++], &attempts[active]);
+			
+			if(ret == 0)
+			{
+				active++;
+				next_start = now + TCONNECT_STAGGER_MS;
+				break;
+			}
+			if(ret == -2) sock_failed++;
+		}
+		if(active == 0)
+		{
+			return (sock_failed == count) ? -2 : -3;
+		}
+		if(deadline >= 0 && now >= deadline)
+		{
+			for(i = 0; i < active; i++) close(attempts[i].fd);
+			return -4;
+		}
+		
+		wait_ms = -1;
+		if(next < count) wait_ms = (int)(next_start - now);
+		if(deadline >= 0 && (wait_ms < 0 || deadline - now < wait_ms)) wait_ms = (int)(deadline - now);
+		if((ready = poll(attempts, active, wait_ms)) == -1 && errno != EINTR)
+		{
+			for(i = 0; i < active; i++) close(attempts[i].fd);
+			return -3;
+		}
+		if(ready <= 0) continue;
+		
+		for(i = 0; i < active; )
+		{
+			int err = 0;
+			socklen_t err_size = sizeof err;
+			
+			if(attempts[i].revents == 0)
+			{
+				i++;
+				continue;
+			}
+			if(getsockopt(attempts[i].fd, SOL_SOCKET, SO_ERROR, &err, &err_size) == 0 && err == 0)
+			{
+				int winner = attempts[i].fd;
+				
+				for(j = 0; j < active; j++)
+				{
+					if(j != i) close(attempts[j].fd);
+				}
+				set_nonblock(winner, 0);
+				return winner;
+			}
+			// Failed attempt: drop it and let the next one start right away
+			close(attempts[i].fd);
+			attempts[i] = attempts[--active];
+			next_start = now;
+		}
+	}
+}
+
+
 #define TCONNECT_ERRS (3)
 #define TCONNECT_ERR_ADDR (-1)
 #define TCONNECT_ERR_ADDR_STR "Unable to resolve address"
@@ -43,6 +616,8 @@ GIT: https://github.com/garbaz/netlib
 
 /**
  * Connects to target host via TCP and returns UNIX file descriptor.
+ * If the target resolves to multiple addresses, connection attempts to all of them are raced (staggered by TCONNECT_STAGGER_MS)
+ * and the first one to connect wins.
  * 
  * char* target:      IP or web address of host to connect to (e.g. "192.168.0.1", "www.example.com")
  * char* target_port: Port to connect to at target (e.g. "80", "1729")
@@ -57,86 +632,411 @@ GIT: https://github.com/garbaz/netlib
 int tconnect(char* target, char* target_port)
 {
 	int retfd;
-	struct addrinfo hints, *servinfo;
-	
-	memset(&hints, 0, sizeof hints);
-	hints.ai_family = AF_UNSPEC;
-	hints.ai_socktype = SOCK_STREAM;
+	struct addrinfo *servinfo;
+	struct sockaddr_storage addr;
+	socklen_t addr_size;
 	
-	if(getaddrinfo(target, target_port, &hints, &servinfo) != 0)
+	if(dns_numeric(target, target_port, &addr, &addr_size) == 0)
 	{
-		return -1;
+		// Literal address: no resolver, no allocation
+		if((retfd = socket(addr.ss_family, SOCK_STREAM, 0)) == -1)
+		{
+			return -2;
+		}
+		if(connect(retfd, (struct sockaddr*)&addr, addr_size) == -1)
+		{
+			close(retfd);
+			return -3;
+		}
+		return retfd;
 	}
 	
-	if((retfd = socket(servinfo->ai_family, servinfo->ai_socktype, servinfo->ai_protocol)) == -1)
+	if(dns_lookup(target, target_port, SOCK_STREAM, 0, &servinfo) != 0)
 	{
-		return -2;
+		return -1;
 	}
 	
-	if(connect(retfd, servinfo->ai_addr, servinfo->ai_addrlen) == -1)
-	{
-		return -3;
-	}
-	freeaddrinfo(servinfo);
+	retfd = tconnect__race(servinfo, -1);
+	dns_release(servinfo);
 	return retfd;
 }
 
-#define TDISCONNECT_ERRS (0)
-#define TDISCONNECT_ERR__STR(err) ""
+#define TCONNECT_TIMEOUT_ERRS (4)
+#define TCONNECT_TIMEOUT_ERR_ADDR (-1)
+#define TCONNECT_TIMEOUT_ERR_ADDR_STR "Unable to resolve address"
+#define TCONNECT_TIMEOUT_ERR_SOCK (-2)
+#define TCONNECT_TIMEOUT_ERR_SOCK_STR "Unable to set up socket"
+#define TCONNECT_TIMEOUT_ERR_CONN (-3)
+#define TCONNECT_TIMEOUT_ERR_CONN_STR "Unable to connect to server"
+#define TCONNECT_TIMEOUT_ERR_TIMEOUT (-4)
+#define TCONNECT_TIMEOUT_ERR_TIMEOUT_STR "Connecting to server timed out"
+
+#define TCONNECT_TIMEOUT_ERR__STR(err) ((err == TCONNECT_TIMEOUT_ERR_ADDR) ? TCONNECT_TIMEOUT_ERR_ADDR_STR : (err == TCONNECT_TIMEOUT_ERR_SOCK) ? TCONNECT_TIMEOUT_ERR_SOCK_STR : (err == TCONNECT_TIMEOUT_ERR_CONN) ? TCONNECT_TIMEOUT_ERR_CONN_STR : (err == TCONNECT_TIMEOUT_ERR_TIMEOUT) ? TCONNECT_TIMEOUT_ERR_TIMEOUT_STR : "")
 
 /**
- * Disconnects TCP stream in both directions.
+ * Connects to target host via TCP like tconnect, but gives up once [timeout_ms] passed.
+ * 
+ * const char* target:      IP or web address of host to connect to (e.g. "192.168.0.1", "www.example.com")
+ * const char* target_port: Port to connect to at target (e.g. "80", "1729")
+ * int timeout_ms:          Maximum time connecting may take in milliseconds (resolving the address excluded)
+ * 
+ * return:                  Returns UNIX file descriptor to which one can write. Returns error code upon failure (error codes below)
  * 
+ * {error codes}:
+ *  Unable to resolve address =>      -1
+ *  Unable to set up socket =>        -2
+ *  Unable to connect to server =>    -3
+ *  Connecting to server timed out => -4
  */
-void tdisconnect(int targetfd)
+int tconnect_timeout(const char* target, const char* target_port, int timeout_ms)
 {
-	shutdown(targetfd, 2);
+	int retfd;
+	struct addrinfo *servinfo, numeric;
+	struct sockaddr_storage addr;
+	socklen_t addr_size;
+	
+	if(dns_numeric(target, target_port, &addr, &addr_size) == 0)
+	{
+		memset(&numeric, 0, sizeof numeric);
+		numeric.ai_family = addr.ss_family;
+		numeric.ai_socktype = SOCK_STREAM;
+		numeric.ai_addr = (struct sockaddr*)&addr;
+		numeric.ai_addrlen = addr_size;
+		return tconnect__race(&numeric, timeout_ms);
+	}
+	
+	if(dns_lookup(target, target_port, SOCK_STREAM, 0, &servinfo) != 0)
+	{
+		return -1;
+	}
+	retfd = tconnect__race(servinfo, timeout_ms);
+	dns_release(servinfo);
+	return retfd;
 }
 
 
-#define TSEND_ERRS (1)
-#define TSEND_ERR_SEND (-1)
-#define TSEND_ERR_SEND_STR "Unable to send data"
+#define TCONNECT_ASYNC_MAX_ADDRS (8)
 
-#define TSEND_ERR__STR(err) ((err==TSEND_ERR_SEND) ? TSEND_ERR_SEND_STR : "")
+/* Addresses tconnect_async falls back on, consumed by tconnect_next */
+struct tconnect_op
+{
+	int fd;
+	int next;
+	int count;
+	struct sockaddr_in6 addrs[TCONNECT_ASYNC_MAX_ADDRS]; // IPv4 addresses fit as well
+	socklen_t addr_sizes[TCONNECT_ASYNC_MAX_ADDRS];
+};
 
-/**
-* Sends data via TCP to a target host.
-* 
-* int targetfd:    UNIX file descriptor of target (With TCP connection established)
-* char* bytes:     Pointer to the bytes which will be sent.
-* int &bytes_size: Number of bytes to send (size of [char* bytes]).
-* 
-* return:          Returns 0 upon success and error code upon failure
-* 
-* {error codes}:
-*  Unable to send data =>                     -1
-*/
-int tsend(int targetfd, char* bytes, int bytes_size)
+/* Starts connecting to the next address in [op] whose socket can be set up. Returns the file descriptor and -2/-3 if none is left. */
+static int tconnect__resume(struct tconnect_op *op)
 {
-	int bytes_sent = 0;
-	do
+	int fd, ret = -2;
+	
+	while(op->next < op->count)
 	{
-		bytes_sent = send(targetfd, bytes, bytes_size, 0);
-		if(bytes_sent == -1) return -1;
-	}while(bytes_sent < bytes_size);
-	return 0;
+		struct sockaddr *addr = (struct sockaddr*)&op->addrs[op->next];
+		socklen_t addr_size = op->addr_sizes[op->next];
+		
+		op->next++;
+		if((fd = socket(addr->sa_family, SOCK_STREAM | SOCK_NONBLOCK, 0)) == -1)
+		{
+			continue;
+		}
+		if(connect(fd, addr, addr_size) == -1 && errno != EINPROGRESS)
+		{
+			close(fd);
+			ret = -3;
+			continue;
+		}
+		return op->fd = fd;
+	}
+	return op->fd = ret;
 }
 
-#define TRECV_ERRS (1)
-#define TRECV_ERR_NODATA (-1)
-#define TRECV_ERR_NODATA_STR "Recieved no data or target disconnected"
+#define TCONNECT_ASYNC_ERRS (3)
+#define TCONNECT_ASYNC_ERR_ADDR (-1)
+#define TCONNECT_ASYNC_ERR_ADDR_STR "Unable to resolve address"
+#define TCONNECT_ASYNC_ERR_SOCK (-2)
+#define TCONNECT_ASYNC_ERR_SOCK_STR "Unable to set up socket"
+#define TCONNECT_ASYNC_ERR_CONN (-3)
+#define TCONNECT_ASYNC_ERR_CONN_STR "Unable to connect to server"
 
-#define TRECV_ERR__STR(err) ((err == TRECV_ERR_NODATA) ? TRECV_ERR_NODATA_STR : "")
+#define TCONNECT_ASYNC_ERR__STR(err) ((err == TCONNECT_ASYNC_ERR_ADDR) ? TCONNECT_ASYNC_ERR_ADDR_STR : (err == TCONNECT_ASYNC_ERR_SOCK) ? TCONNECT_ASYNC_ERR_SOCK_STR : (err == TCONNECT_ASYNC_ERR_CONN) ? TCONNECT_ASYNC_ERR_CONN_STR : "")
 
 /**
-* Recieve data from host via TCP.
-* 
-* int targetfd:    UNIX file descriptor of target (With TCP connection established)
-* char* bytes:     Pointer to the bytes where the recieved data will be written.
-* int &bytes_size: Number of bytes allocated at [char* bytes]. Will be set to amount of bytes recieved!
-* 
-* return:          Returns 0 upon success and error code upon failure
+ * Starts connecting to target host via TCP without waiting for the connection to be established.
+ * The returned file descriptor is non-blocking. Watch it for EPOLLOUT (e.g. with reactor_add) and call
+ * tconnect_finish once it is writable. A deadline can be enforced with reactor_add_timer.
+ * The other resolved addresses (up to TCONNECT_ASYNC_MAX_ADDRS) are kept in [op], if tconnect_finish
+ * fails, tconnect_next moves on to the next one, just like tconnect does.
+ * 
+ * const char* target:      IP or web address of host to connect to (e.g. "192.168.0.1", "www.example.com")
+ * const char* target_port: Port to connect to at target (e.g. "80", "1729")
+ * struct tconnect_op *op:  Pointer in which the addresses to fall back on will be saved (may be NULL to only try the first)
+ * 
+ * return:                  Returns UNIX file descriptor with the connection in progress. Returns error code upon failure (error codes below)
+ * 
+ * {error codes}:
+ *  Unable to resolve address =>   -1
+ *  Unable to set up socket =>     -2
+ *  Unable to connect to server => -3
+ */
+int tconnect_async(const char* target, const char* target_port, struct tconnect_op *op)
+{
+	struct tconnect_op local;
+	struct addrinfo *servinfo, *p;
+	struct sockaddr_storage addr;
+	socklen_t addr_size;
+	
+	if(op == NULL) op = &local;
+	op->fd = -1;
+	op->next = op->count = 0;
+	if(dns_numeric(target, target_port, &addr, &addr_size) == 0)
+	{
+		memcpy(&op->addrs[0], &addr, addr_size);
+		op->addr_sizes[0] = addr_size;
+		op->count = 1;
+	}
+	else
+	{
+		if(dns_lookup(target, target_port, SOCK_STREAM, 0, &servinfo) != 0)
+		{
+			return -1;
+		}
+		for(p = servinfo; p != NULL && op->count < ((op == &local) ? 1 : TCONNECT_ASYNC_MAX_ADDRS); p = p->ai_next)
+		{
+			if(p->ai_addrlen > sizeof op->addrs[0]) continue;
+			memcpy(&op->addrs[op->count], p->ai_addr, p->ai_addrlen);
+			op->addr_sizes[op->count] = p->ai_addrlen;
+			op->count++;
+		}
+		dns_release(servinfo);
+	}
+	return tconnect__resume(op);
+}
+
+
+#define TCONNECT_NEXT_ERRS (1)
+#define TCONNECT_NEXT_ERR_CONN (-1)
+#define TCONNECT_NEXT_ERR_CONN_STR "Unable to connect to server"
+
+#define TCONNECT_NEXT_ERR__STR(err) ((err == TCONNECT_NEXT_ERR_CONN) ? TCONNECT_NEXT_ERR_CONN_STR : "")
+
+/**
+ * Gives up on the connection attempt in [op] after tconnect_finish failed: closes its file descriptor and starts
+ * connecting to the next address tconnect_async resolved. Unregister the old file descriptor (e.g. with reactor_del) first.
+ * 
+ * struct tconnect_op *op: Connection attempt set up by tconnect_async
+ * 
+ * return:                 Returns the new UNIX file descriptor with the connection in progress and error code if no address is left
+ * 
+ * {error codes}:
+ *  Unable to connect to server => -1
+ */
+int tconnect_next(struct tconnect_op *op)
+{
+	if(op->fd >= 0) close(op->fd);
+	if(tconnect__resume(op) < 0)
+	{
+		return -1;
+	}
+	return op->fd;
+}
+
+
+#define TCONNECT_FINISH_ERRS (2)
+#define TCONNECT_FINISH_ERR_CONN (-1)
+#define TCONNECT_FINISH_ERR_CONN_STR "Unable to connect to server"
+#define TCONNECT_FINISH_ERR_PENDING (-2)
+#define TCONNECT_FINISH_ERR_PENDING_STR "Connection still in progress"
+
+#define TCONNECT_FINISH_ERR__STR(err) ((err == TCONNECT_FINISH_ERR_CONN) ? TCONNECT_FINISH_ERR_CONN_STR : (err == TCONNECT_FINISH_ERR_PENDING) ? TCONNECT_FINISH_ERR_PENDING_STR : "")
+
+/**
+ * Checks the outcome of a connection started with tconnect_async.
+ * Upon failure the file descriptor is left open, the caller is responsible for closing it (or tconnect_next).
+ * 
+ * int targetfd: UNIX file descriptor returned by tconnect_async
+ * 
+ * return:       Returns 0 if the connection is established and error code otherwise
+ * 
+ * {error codes}:
+ *  Unable to connect to server =>  -1
+ *  Connection still in progress => -2
+ */
+int tconnect_finish(int targetfd)
+{
+	struct sockaddr_storage peer;
+	socklen_t peer_size = sizeof peer;
+	int err = 0;
+	socklen_t err_size = sizeof err;
+	
+	if(getsockopt(targetfd, SOL_SOCKET, SO_ERROR, &err, &err_size) == -1 || err != 0)
+	{
+		return -1;
+	}
+	if(getpeername(targetfd, (struct sockaddr*)&peer, &peer_size) == -1)
+	{
+		return (errno == ENOTCONN) ? -2 : -1;
+	}
+	return 0;
+}
+
+#define TDISCONNECT_ERRS (0)
+#define TDISCONNECT_ERR__STR(err) ""
+
+/**
+ * Disconnects TCP stream in both directions.
+ * 
+ */
+void tdisconnect(int targetfd)
+{
+	shutdown(targetfd, 2);
+}
+
+
+/* Waits until [fd] is ready for [events]. Returns 1 when ready, 0 on timeout and -1 upon failure. */
+static int netlib__poll(int fd, short events, int timeout_ms)
+{
+	struct pollfd pfd;
+	int ret;
+	
+	pfd.fd = fd;
+	pfd.events = events;
+	pfd.revents = 0;
+	do
+	{
+		ret = poll(&pfd, 1, timeout_ms);
+	}while(ret == -1 && errno == EINTR);
+	return ret;
+}
+
+#define TSENDV_ERRS (1)
+#define TSENDV_ERR_SEND (-1)
+#define TSENDV_ERR_SEND_STR "Unable to send data"
+
+#define TSENDV_ERR__STR(err) ((err == TSENDV_ERR_SEND) ? TSENDV_ERR_SEND_STR : "")
+
+/**
+* Sends a scatter/gather list of buffers via TCP to a target host in as few syscalls as possible (e.g. header and payload at once).
+* Short writes are continued, interrupted calls are restarted and on non-blocking sockets it waits until the socket is writable again.
+* [iov] is consumed in place: after returning, it describes the bytes which were not sent (nothing upon success).
+* 
+* int targetfd:       UNIX file descriptor of target (With TCP connection established)
+* struct iovec *iov:  Array of buffers which will be sent in order
+* int iovcnt:         Number of entries in [iov]
+* ssize_t *sent_size: Pointer in which the number of bytes sent will be saved, also upon failure (may be NULL)
+* 
+* return:             Returns number of bytes sent (which may exceed INT_MAX for large lists) and error code upon failure
+* 
+* {error codes}:
+*  Unable to send data => -1
+*/
+ssize_t tsendv(int targetfd, struct iovec *iov, int iovcnt, ssize_t *sent_size)
+{
+	struct msghdr msg;
+	ssize_t sent;
+	ssize_t total = 0;
+	int use_writev = 0;
+	
+	while(iovcnt > 0)
+	{
+		if(iov->iov_len == 0)
+		{
+			iov++;
+			iovcnt--;
+			continue;
+		}
+		
+		if(use_writev)
+		{
+			sent = writev(targetfd, iov, (iovcnt > IOV_MAX) ? IOV_MAX : iovcnt);
+		}
+		else
+		{
+			memset(&msg, 0, sizeof msg);
+			msg.msg_iov = iov;
+			msg.msg_iovlen = (iovcnt > IOV_MAX) ? IOV_MAX : iovcnt;
+			sent = sendmsg(targetfd, &msg, MSG_NOSIGNAL);
+		}
+		if(sent == -1)
+		{
+			if(errno == EINTR) continue;
+			if(errno == ENOTSOCK && !use_writev)
+			{
+				// Not a socket (e.g. a pipe), plain writev does the same job
+				use_writev = 1;
+				continue;
+			}
+			if((errno == EAGAIN || errno == EWOULDBLOCK) && netlib__poll(targetfd, POLLOUT, -1) == 1) continue;
+			if(sent_size != NULL) *sent_size = total;
+			return -1;
+		}
+		
+		total += sent;
+		while(sent > 0)
+		{
+			if((size_t)sent < iov->iov_len)
+			{
+				iov->iov_base = (char*)iov->iov_base + sent;
+				iov->iov_len -= sent;
+				break;
+			}
+			sent -= iov->iov_len;
+			iov->iov_len = 0;
+			iov++;
+			iovcnt--;
+		}
+	}
+	if(sent_size != NULL) *sent_size = total;
+	return total;
+}
+
+#define TSEND_ERRS (1)
+#define TSEND_ERR_SEND (-1)
+#define TSEND_ERR_SEND_STR "Unable to send data"
+
+#define TSEND_ERR__STR(err) ((err==TSEND_ERR_SEND) ? TSEND_ERR_SEND_STR : "")
+
+/**
+* Sends data via TCP to a target host. Short writes are continued until all bytes are sent.
+* 
+* int targetfd:    UNIX file descriptor of target (With TCP connection established)
+* char* bytes:     Pointer to the bytes which will be sent.
+* int &bytes_size: Number of bytes to send (size of [char* bytes]).
+* 
+* return:          Returns 0 upon success and error code upon failure
+* 
+* {error codes}:
+*  Unable to send data =>                     -1
+*/
+int tsend(int targetfd, char* bytes, int bytes_size)
+{
+	struct iovec iov;
+	
+	iov.iov_base = bytes;
+	iov.iov_len = bytes_size;
+	if(tsendv(targetfd, &iov, 1, NULL) < 0)
+	{
+		return -1;
+	}
+	return 0;
+}
+
+#define TRECV_ERRS (1)
+#define TRECV_ERR_NODATA (-1)
+#define TRECV_ERR_NODATA_STR "Recieved no data or target disconnected"
+
+#define TRECV_ERR__STR(err) ((err == TRECV_ERR_NODATA) ? TRECV_ERR_NODATA_STR : "")
+
+/**
+* Recieve data from host via TCP.
+* 
+* int targetfd:    UNIX file descriptor of target (With TCP connection established)
+* char* bytes:     Pointer to the bytes where the recieved data will be written.
+* int &bytes_size: Number of bytes allocated at [char* bytes]. Will be set to amount of bytes recieved!
+* 
+* return:          Returns 0 upon success and error code upon failure
 * 
 * {error codes}:
 *  Recieved no data / target disconnected =>  -1
@@ -150,6 +1050,50 @@ int trecv(int targetfd, char* bytes, int *bytes_size)
 	return 0;
 }
 
+#define TRECV_EXACT_ERRS (2)
+#define TRECV_EXACT_ERR_NODATA (-1)
+#define TRECV_EXACT_ERR_NODATA_STR "Target disconnected before all data was received"
+#define TRECV_EXACT_ERR_RECV (-2)
+#define TRECV_EXACT_ERR_RECV_STR "Unable to receive data"
+
+#define TRECV_EXACT_ERR__STR(err) ((err == TRECV_EXACT_ERR_NODATA) ? TRECV_EXACT_ERR_NODATA_STR : (err == TRECV_EXACT_ERR_RECV) ? TRECV_EXACT_ERR_RECV_STR : "")
+
+/**
+* Receives exactly [bytes_size] bytes from host via TCP.
+* Blocks until all bytes arrived (on non-blocking sockets it waits until the socket is readable again).
+* 
+* int targetfd:   UNIX file descriptor of target (With TCP connection established)
+* char* bytes:    Pointer to the bytes where the received data will be written
+* int bytes_size: Number of bytes to receive
+* 
+* return:         Returns 0 upon success and error code upon failure
+* 
+* {error codes}:
+*  Target disconnected before all data was received => -1
+*  Unable to receive data =>                           -2
+*/
+int trecv_exact(int targetfd, char* bytes, int bytes_size)
+{
+	ssize_t received;
+	
+	while(bytes_size > 0)
+	{
+		if((received = recv(targetfd, bytes, bytes_size, MSG_WAITALL)) == -1)
+		{
+			if(errno == EINTR) continue;
+			if((errno == EAGAIN || errno == EWOULDBLOCK) && netlib__poll(targetfd, POLLIN, -1) == 1) continue;
+			return -2;
+		}
+		if(received == 0)
+		{
+			return -1;
+		}
+		bytes += received;
+		bytes_size -= (int)received;
+	}
+	return 0;
+}
+
 #define TSEND_RECV_ERRS (2)
 #define TSEND_RECV_ERR_SEND (-1)
 #define TSEND_RECV_ERR_SEND_STR "Unable to send data"
@@ -173,12 +1117,10 @@ int trecv(int targetfd, char* bytes, int *bytes_size)
 */
 int tsend_recv(int targetfd, char* bytes, int *bytes_size)
 {
-	int bytes_sent = 0;
-	do
+	if(tsend(targetfd, bytes, *bytes_size) < 0)
 	{
-		bytes_sent = send(targetfd, bytes, *bytes_size, 0);
-		if(bytes_sent == -1) return -1;
-	}while(bytes_sent < *bytes_size);
+		return -1;
+	}
 	
 	if((*bytes_size = recv(targetfd, bytes, *bytes_size, 0)) < 1)
 	{
@@ -187,331 +1129,6409 @@ int tsend_recv(int targetfd, char* bytes, int *bytes_size)
 	return 0;
 }
 
-#define TCREATE_HOST_ERRS (4)
-#define TCREATE_HOST_ERR_ADDR (-1)
-#define TCREATE_HOST_ERR_ADDR_STR "Unable to resolve address"
-#define TCREATE_HOST_ERR_FD (-2)
-#define TCREATE_HOST_ERR_FD_STR "Unable to set up files descriptor"
-#define TCREATE_HOST_ERR_PORT (-3)
-#define TCREATE_HOST_ERR_PORT_STR "Unable to bind to port"
-#define TCREATE_HOST_ERR_FPORT (-4)
-#define TCREATE_HOST_ERR_FPORT_STR "Unable to force bind to port"
 
-#define TCREATE_HOST_ERR__STR(err) ((err == TCREATE_HOST_ERR_ADDR) ? TCREATE_HOST_ERR_ADDR : (err == TCREATE_HOST_ERR_FD) ? TCREATE_HOST_ERR_FD_STR :(err == TCREATE_HOST_ERR_PORT) ? TCREATE_HOST_ERR_PORT_STR : (err == TCREATE_HOST_ERR_FPORT) ? TCREATE_HOST_ERR_FPORT_STR : "")
+/*
+Zero-copy sending:
+	For large sends the copy into the socket buffer dominates the CPU cost. With MSG_ZEROCOPY the kernel sends
+	straight from the caller's pages instead, so the buffer must not be touched until the kernel reports it is done.
+	These reports arrive on the socket's error queue (poll / epoll signal them as POLLERR / EPOLLERR) and are
+	collected by tzc_reap, which then invokes the callback passed to tsend_zc:
+		tsend_zc(&z, blob, blob_size, blob_release, blob);
+		...on EPOLLERR: tzc_reap(&z);
+	Sends below [min_size] are copied as usual (pinning pages costs more than copying them), their callback runs right away.
+	Over loopback the kernel always copies, the callback then reports [copied].
+*/
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+#define TZC_MIN_SIZE (16384)
+
+typedef void (*tzc_cb)(void *arg, int copied);
+
+struct tzc_pending
+{
+	uint32_t first_id;
+	uint32_t last_id;
+	uint32_t remaining;
+	int copied;
+	tzc_cb cb;
+	void *arg;
+};
+
+struct tzc
+{
+	int fd;
+	int enabled;
+	int min_size;
+	uint32_t next_id;
+	struct tzc_pending *pending;
+	int pending_size;
+	int pending_head;
+	int pending_count;
+};
+
+
+#define TZC_CREATE_ERRS (1)
+#define TZC_CREATE_ERR_MEM (-1)
+#define TZC_CREATE_ERR_MEM_STR "Unable to allocate memory"
+
+#define TZC_CREATE_ERR__STR(err) ((err == TZC_CREATE_ERR_MEM) ? TZC_CREATE_ERR_MEM_STR : "")
+
+/**
+ * Enables zero-copy sending on a TCP connection. If the kernel does not support it, all sends are copied.
+ * 
+ * struct tzc *z: Pointer to the zero-copy state to initialize
+ * int targetfd:  UNIX file descriptor of target (With TCP connection established)
+ * int min_size:  Sends smaller than this are copied (0 for TZC_MIN_SIZE)
+ * 
+ * return:        Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to allocate memory => -1
+ */
+int tzc_create(struct tzc *z, int targetfd, int min_size)
+{
+	int one = 1;
+	
+	memset(z, 0, sizeof *z);
+	z->fd = targetfd;
+	z->min_size = (min_size > 0) ? min_size : TZC_MIN_SIZE;
+	z->enabled = (setsockopt(targetfd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof one) == 0);
+	z->pending_size = 64;
+	if((z->pending = (struct tzc_pending*)malloc(z->pending_size * sizeof *z->pending)) == NULL)
+	{
+		return -1;
+	}
+	return 0;
+}
+
+/* Makes room for one more pending send, keeping the entries in send order */
+static int tzc__reserve(struct tzc *z)
+{
+	struct tzc_pending *new_pending;
+	int i;
+	
+	if(z->pending_count < z->pending_size) return 0;
+	if((new_pending = (struct tzc_pending*)malloc(2 * z->pending_size * sizeof *new_pending)) == NULL)
+	{
+		return -1;
+	}
+	for(i = 0; i < z->pending_count; i++)
+	{
+		new_pending[i] = z->pending[(z->pending_head + i) % z->pending_size];
+	}
+	free(z->pending);
+	z->pending = new_pending;
+	z->pending_size *= 2;
+	z->pending_head = 0;
+	return 0;
+}
+
+
+#define TZC_REAP_ERRS (1)
+#define TZC_REAP_ERR_RECV (-1)
+#define TZC_REAP_ERR_RECV_STR "Unable to read error queue"
+
+#define TZC_REAP_ERR__STR(err) ((err == TZC_REAP_ERR_RECV) ? TZC_REAP_ERR_RECV_STR : "")
+
+/**
+ * Reads all completion reports from the error queue and invokes the callbacks of finished sends (in send order). Never blocks.
+ * 
+ * struct tzc *z: Zero-copy state of the connection
+ * 
+ * return:        Returns number of invoked callbacks and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to read error queue => -1
+ */
+int tzc_reap(struct tzc *z)
+{
+	char control[CMSG_SPACE(sizeof(struct sock_extended_err)) + CMSG_SPACE(sizeof(struct sockaddr_in6))];
+	struct msghdr msg;
+	struct cmsghdr *cm;
+	struct sock_extended_err *serr;
+	int i, done = 0;
+	
+	for(;;)
+	{
+		memset(&msg, 0, sizeof msg);
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof control;
+		if(recvmsg(z->fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1)
+		{
+			if(errno == EINTR) continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+			return -1;
+		}
+		for(cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm))
+		{
+			serr = (struct sock_extended_err*)CMSG_DATA(cm);
+			if(serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+			
+			// Report covers send ids [ee_info, ee_data], usually in order but that is not guaranteed
+			for(i = 0; i < z->pending_count; i++)
+			{
+				struct tzc_pending *p = &z->pending[(z->pending_head + i) % z->pending_size];
+				int32_t lo = (int32_t)(serr->ee_info - p->first_id);
+				int32_t hi = (int32_t)(serr->ee_data - p->first_id);
+				int32_t last = (int32_t)(p->last_id - p->first_id);
+				
+				if(lo < 0) lo = 0;
+				if(hi > last) hi = last;
+				if(hi < lo) continue;
+				p->remaining -= (uint32_t)(hi - lo + 1);
+				if(serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) p->copied = 1;
+			}
+		}
+	}
+	
+	while(z->pending_count > 0 && z->pending[z->pending_head].remaining == 0)
+	{
+		struct tzc_pending p = z->pending[z->pending_head];
+		
+		z->pending_head = (z->pending_head + 1) % z->pending_size;
+		z->pending_count--;
+		if(p.cb != NULL) p.cb(p.arg, p.copied);
+		done++;
+	}
+	return done;
+}
+
+
+#define TSEND_ZC_ERRS (2)
+#define TSEND_ZC_ERR_SEND (-1)
+#define TSEND_ZC_ERR_SEND_STR "Unable to send data"
+#define TSEND_ZC_ERR_MEM (-2)
+#define TSEND_ZC_ERR_MEM_STR "Unable to allocate memory"
+
+#define TSEND_ZC_ERR__STR(err) ((err == TSEND_ZC_ERR_SEND) ? TSEND_ZC_ERR_SEND_STR : (err == TSEND_ZC_ERR_MEM) ? TSEND_ZC_ERR_MEM_STR : "")
+
+/**
+ * Sends data via TCP without copying it into the kernel (falls back to a copy for small sends). Blocks until all bytes are queued.
+ * [bytes] must stay untouched until [cb] was invoked by tzc_reap (or right away for copied sends).
+ * If sending fails part way, [cb] is still invoked once the kernel released the bytes already queued.
+ * 
+ * struct tzc *z:  Zero-copy state of the connection
+ * char* bytes:    Data to send
+ * int bytes_size: Number of bytes to send
+ * tzc_cb cb:      Callback invoked once [bytes] can be reused (may be NULL)
+ * void *arg:      Pointer handed to [cb] untouched
+ * 
+ * return:         Returns [bytes_size] upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to send data =>       -1
+ *  Unable to allocate memory => -2
+ */
+int tsend_zc(struct tzc *z, char* bytes, int bytes_size, tzc_cb cb, void *arg)
+{
+	struct tzc_pending *p;
+	struct msghdr msg;
+	struct iovec iov;
+	ssize_t sent;
+	uint32_t first_id = z->next_id;
+	int done = 0;
+	int ret = bytes_size;
+	
+	if(!z->enabled || bytes_size < z->min_size)
+	{
+		if(tsend(z->fd, bytes, bytes_size) < 0)
+		{
+			return -1;
+		}
+		if(cb != NULL) cb(arg, 1);
+		return bytes_size;
+	}
+	if(tzc__reserve(z) < 0)
+	{
+		return -2;
+	}
+	
+	while(done < bytes_size)
+	{
+		memset(&msg, 0, sizeof msg);
+		iov.iov_base = bytes + done;
+		iov.iov_len = bytes_size - done;
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		if((sent = sendmsg(z->fd, &msg, MSG_ZEROCOPY | MSG_NOSIGNAL)) == -1)
+		{
+			if(errno == EINTR) continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				tzc_reap(z);
+				if(netlib__poll(z->fd, POLLOUT, -1) == 1) continue;
+			}
+			// Too many pages pinned: wait for the kernel to release some of them
+			else if(errno == ENOBUFS && z->next_id != first_id && netlib__poll(z->fd, 0, -1) == 1)
+			{
+				tzc_reap(z);
+				continue;
+			}
+			ret = -1;
+			break;
+		}
+		// Every successful call gets the next id, even a short one
+		z->next_id++;
+		done += (int)sent;
+	}
+	
+	if(z->next_id == first_id)
+	{
+		return ret;
+	}
+	p = &z->pending[(z->pending_head + z->pending_count) % z->pending_size];
+	p->first_id = first_id;
+	p->last_id = z->next_id - 1;
+	p->remaining = z->next_id - first_id;
+	p->copied = 0;
+	p->cb = cb;
+	p->arg = arg;
+	z->pending_count++;
+	return ret;
+}
+
+
+#define TZC_FLUSH_ERRS (2)
+#define TZC_FLUSH_ERR_RECV (-1)
+#define TZC_FLUSH_ERR_RECV_STR "Unable to read error queue"
+#define TZC_FLUSH_ERR_TIMEOUT (-2)
+#define TZC_FLUSH_ERR_TIMEOUT_STR "Timed out waiting for completions"
+
+#define TZC_FLUSH_ERR__STR(err) ((err == TZC_FLUSH_ERR_RECV) ? TZC_FLUSH_ERR_RECV_STR : (err == TZC_FLUSH_ERR_TIMEOUT) ? TZC_FLUSH_ERR_TIMEOUT_STR : "")
+
+/**
+ * Waits until the kernel released all buffers of pending zero-copy sends and invoked their callbacks.
+ * 
+ * struct tzc *z:  Zero-copy state of the connection
+ * int timeout_ms: Maximum time to wait for a single completion report in milliseconds (-1 to wait forever)
+ * 
+ * return:         Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to read error queue =>        -1
+ *  Timed out waiting for completions => -2
+ */
+int tzc_flush(struct tzc *z, int timeout_ms)
+{
+	while(z->pending_count > 0)
+	{
+		if(tzc_reap(z) < 0)
+		{
+			return -1;
+		}
+		if(z->pending_count == 0) break;
+		// The error queue is reported as POLLERR, which needs no event flag
+		if(netlib__poll(z->fd, 0, timeout_ms) != 1)
+		{
+			return -2;
+		}
+	}
+	return 0;
+}
+
+#define TZC_DESTROY_ERRS (0)
+#define TZC_DESTROY_ERR__STR(err) ""
+
+/**
+ * Frees the zero-copy state. Callbacks of still pending sends are not invoked, call tzc_flush first.
+ * 
+ */
+void tzc_destroy(struct tzc *z)
+{
+	free(z->pending);
+	z->pending = NULL;
+	z->pending_count = 0;
+}
+
+/*
+File streaming:
+	tsend_file and trecv_to_file move file contents between a file and a TCP connection inside the kernel
+	(sendfile, respectively splice through a pipe), the data never passes through a user buffer.
+	Both work in chunks of TFILE_CHUNK bytes, report progress after every chunk and keep [offset] up to date,
+	so an interrupted transfer can be resumed by calling them again with the same [offset]:
+		off_t offset = 0;
+		while(tsend_file(fd, file_fd, &offset, -1, NULL, NULL) < 0) { reconnect... }
+*/
+
+#define TFILE_CHUNK (4 << 20)
+
+typedef void (*tfile_cb)(long long done, void *arg);
+
+
+#define TSEND_FILE_ERRS (2)
+#define TSEND_FILE_ERR_FILE (-1)
+#define TSEND_FILE_ERR_FILE_STR "Unable to read file"
+#define TSEND_FILE_ERR_SEND (-2)
+#define TSEND_FILE_ERR_SEND_STR "Unable to send data"
+
+#define TSEND_FILE_ERR__STR(err) ((err == TSEND_FILE_ERR_FILE) ? TSEND_FILE_ERR_FILE_STR : (err == TSEND_FILE_ERR_SEND) ? TSEND_FILE_ERR_SEND_STR : "")
+
+/**
+ * Sends (part of) a file via TCP using sendfile. Blocks until done, on non-blocking sockets it waits until the socket is writable again.
+ * 
+ * int targetfd:    UNIX file descriptor of target (With TCP connection established)
+ * int file_fd:     UNIX file descriptor of the file to send
+ * off_t *offset:   Position in the file to start at, advanced by the bytes sent (NULL to use and advance the file position)
+ * long long len:   Number of bytes to send (-1 to send up to the end of the file)
+ * tfile_cb cb:     Callback invoked with the number of bytes sent so far after every chunk (may be NULL)
+ * void *arg:       Pointer handed to [cb] untouched
+ * 
+ * return:          Returns number of bytes sent and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to read file => -1
+ *  Unable to send data => -2
+ */
+long long tsend_file(int targetfd, int file_fd, off_t *offset, long long len, tfile_cb cb, void *arg)
+{
+	struct stat st;
+	long long done = 0;
+	ssize_t sent;
+	
+	if(len < 0)
+	{
+		off_t start = (offset != NULL) ? *offset : lseek(file_fd, 0, SEEK_CUR);
+		
+		if(start == -1 || fstat(file_fd, &st) == -1)
+		{
+			return -1;
+		}
+		len = (st.st_size > start) ? st.st_size - start : 0;
+	}
+	
+	while(done < len)
+	{
+		size_t chunk = (len - done > TFILE_CHUNK) ? TFILE_CHUNK : (size_t)(len - done);
+		
+		if((sent = sendfile(targetfd, file_fd, offset, chunk)) == -1)
+		{
+			if(errno == EINTR) continue;
+			if((errno == EAGAIN || errno == EWOULDBLOCK) && netlib__poll(targetfd, POLLOUT, -1) == 1) continue;
+			return -2;
+		}
+		if(sent == 0)
+		{
+			// File is shorter than expected (e.g. truncated meanwhile)
+			return -1;
+		}
+		done += sent;
+		if(cb != NULL) cb(done, arg);
+	}
+	return done;
+}
+
+/* Moves data from [targetfd] through [pipefd] into [file_fd], see trecv_to_file */
+static long long trecv__splice(int targetfd, int pipefd[2], int file_fd, off_t *offset, long long len, tfile_cb cb, void *arg)
+{
+	loff_t pos = (offset != NULL) ? *offset : 0;
+	long long done = 0;
+	ssize_t n, out;
+	
+	while(len < 0 || done < len)
+	{
+		size_t chunk = (len >= 0 && len - done < TFILE_CHUNK) ? (size_t)(len - done) : TFILE_CHUNK;
+		
+		if((n = splice(targetfd, NULL, pipefd[1], NULL, chunk, SPLICE_F_MOVE | SPLICE_F_MORE)) == -1)
+		{
+			if(errno == EINTR) continue;
+			if((errno == EAGAIN || errno == EWOULDBLOCK) && netlib__poll(targetfd, POLLIN, -1) == 1) continue;
+			return -2;
+		}
+		if(n == 0)
+		{
+			return (len < 0) ? done : -4;
+		}
+		
+		// Drain the pipe completely, so it never holds bytes across iterations
+		while(n > 0)
+		{
+			if((out = splice(pipefd[0], NULL, file_fd, (offset != NULL) ? &pos : NULL, n, SPLICE_F_MOVE)) == -1)
+			{
+				if(errno == EINTR) continue;
+				return -3;
+			}
+			n -= out;
+			done += out;
+			if(offset != NULL) *offset = pos;
+		}
+		if(cb != NULL) cb(done, arg);
+	}
+	return done;
+}
+
+
+#define TRECV_TO_FILE_ERRS (4)
+#define TRECV_TO_FILE_ERR_PIPE (-1)
+#define TRECV_TO_FILE_ERR_PIPE_STR "Unable to set up pipe"
+#define TRECV_TO_FILE_ERR_RECV (-2)
+#define TRECV_TO_FILE_ERR_RECV_STR "Unable to receive data"
+#define TRECV_TO_FILE_ERR_FILE (-3)
+#define TRECV_TO_FILE_ERR_FILE_STR "Unable to write file"
+#define TRECV_TO_FILE_ERR_DISCONNECTED (-4)
+#define TRECV_TO_FILE_ERR_DISCONNECTED_STR "Target disconnected before all data was received"
+
+#define TRECV_TO_FILE_ERR__STR(err) ((err == TRECV_TO_FILE_ERR_PIPE) ? TRECV_TO_FILE_ERR_PIPE_STR : (err == TRECV_TO_FILE_ERR_RECV) ? TRECV_TO_FILE_ERR_RECV_STR : (err == TRECV_TO_FILE_ERR_FILE) ? TRECV_TO_FILE_ERR_FILE_STR : (err == TRECV_TO_FILE_ERR_DISCONNECTED) ? TRECV_TO_FILE_ERR_DISCONNECTED_STR : "")
+
+/**
+ * Receives data via TCP straight into a file using splice through a pipe. Blocks until done, on non-blocking sockets it waits until data arrives.
+ * Whatever was received before a failure has been written to the file and is accounted for in [offset].
+ * 
+ * int targetfd:    UNIX file descriptor of target (With TCP connection established)
+ * int file_fd:     UNIX file descriptor of the file to write to
+ * off_t *offset:   Position in the file to write at, advanced by the bytes written (NULL to use and advance the file position)
+ * long long len:   Number of bytes to receive (-1 to receive until the target disconnects)
+ * tfile_cb cb:     Callback invoked with the number of bytes written so far after every chunk (may be NULL)
+ * void *arg:       Pointer handed to [cb] untouched
+ * 
+ * return:          Returns number of bytes written to the file and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to set up pipe =>                            -1
+ *  Unable to receive data =>                           -2
+ *  Unable to write file =>                             -3
+ *  Target disconnected before all data was received => -4
+ */
+long long trecv_to_file(int targetfd, int file_fd, off_t *offset, long long len, tfile_cb cb, void *arg)
+{
+	int pipefd[2];
+	long long ret;
+	
+	if(pipe2(pipefd, O_CLOEXEC) == -1)
+	{
+		return -1;
+	}
+	// A bigger pipe means fewer splice calls, the default of 64K is kept if this is not allowed
+	fcntl(pipefd[1], F_SETPIPE_SZ, 1 << 20);
+	ret = trecv__splice(targetfd, pipefd, file_fd, offset, len, cb, arg);
+	close(pipefd[0]);
+	close(pipefd[1]);
+	return ret;
+}
+
+/*
+Framer:
+	Splits a TCP stream into messages, either prefixed by their length (1, 2 or 4 bytes, big endian)
+	or terminated by a delimiter (e.g. "\r\n"), or split by a callback for any other format (see tframer_create_custom).
+	Every call to tframer_fill reads as much as fits into the framer's buffer with a single recv, after which
+	tframer_next hands out all complete messages in that buffer without further syscalls:
+		if(tframer_fill(&f, fd) < 0) {...}
+		while((ret = tframer_next(&f, &frame, &frame_size)) == 1) {...}
+	Frames point into the framer's buffer and stay valid until the next call to tframer_fill.
+*/
+
+#define TFRAMER_LENGTH (1)
+#define TFRAMER_DELIM (2)
+#define TFRAMER_CUSTOM (3)
+
+/* Returns the size of the complete message at the start of [data], 0 if more data is needed and -1 if [data] is invalid */
+typedef int (*tframer_cb)(const char *data, int size, void *arg);
+
+struct tframer
+{
+	char *buf;
+	int buf_size;
+	int start;
+	int end;
+	int scan;
+	int mode;
+	int prefix_size;
+	const char *delim;
+	int delim_size;
+	tframer_cb frame_cb;
+	void *frame_arg;
+};
+
+
+#define TFRAMER_CREATE_ERRS (2)
+#define TFRAMER_CREATE_ERR_ARG (-1)
+#define TFRAMER_CREATE_ERR_ARG_STR "Invalid framing parameters"
+#define TFRAMER_CREATE_ERR_MEM (-2)
+#define TFRAMER_CREATE_ERR_MEM_STR "Unable to allocate buffer"
+
+#define TFRAMER_CREATE_ERR__STR(err) ((err == TFRAMER_CREATE_ERR_ARG) ? TFRAMER_CREATE_ERR_ARG_STR : (err == TFRAMER_CREATE_ERR_MEM) ? TFRAMER_CREATE_ERR_MEM_STR : "")
+
+/**
+ * Sets up a framer for length prefixed messages.
+ * 
+ * struct tframer *f: Pointer to the framer to initialize
+ * int buf_size:      Size of the internal buffer. Bounds the size of a single message (including its prefix).
+ * int prefix_size:   Size of the big endian length prefix in bytes (1, 2 or 4). The length does not include the prefix.
+ * 
+ * return:            Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Invalid framing parameters => -1
+ *  Unable to allocate buffer =>  -2
+ */
+int tframer_create_length(struct tframer *f, int buf_size, int prefix_size)
+{
+	memset(f, 0, sizeof *f);
+	if(buf_size <= prefix_size || (prefix_size != 1 && prefix_size != 2 && prefix_size != 4))
+	{
+		return -1;
+	}
+	if((f->buf = (char*)malloc(buf_size)) == NULL)
+	{
+		return -2;
+	}
+	f->buf_size = buf_size;
+	f->mode = TFRAMER_LENGTH;
+	f->prefix_size = prefix_size;
+	return 0;
+}
+
+
+#define TFRAMER_CREATE_DELIM_ERRS (2)
+#define TFRAMER_CREATE_DELIM_ERR_ARG (-1)
+#define TFRAMER_CREATE_DELIM_ERR_ARG_STR "Invalid framing parameters"
+#define TFRAMER_CREATE_DELIM_ERR_MEM (-2)
+#define TFRAMER_CREATE_DELIM_ERR_MEM_STR "Unable to allocate buffer"
+
+#define TFRAMER_CREATE_DELIM_ERR__STR(err) ((err == TFRAMER_CREATE_DELIM_ERR_ARG) ? TFRAMER_CREATE_DELIM_ERR_ARG_STR : (err == TFRAMER_CREATE_DELIM_ERR_MEM) ? TFRAMER_CREATE_DELIM_ERR_MEM_STR : "")
+
+/**
+ * Sets up a framer for delimiter terminated messages.
+ * 
+ * struct tframer *f: Pointer to the framer to initialize
+ * int buf_size:      Size of the internal buffer. Bounds the size of a single message (including its delimiter).
+ * const char* delim: Delimiter terminating every message (not copied, must stay valid)
+ * int delim_size:    Size of [delim] in bytes
+ * 
+ * return:            Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Invalid framing parameters => -1
+ *  Unable to allocate buffer =>  -2
+ */
+int tframer_create_delim(struct tframer *f, int buf_size, const char* delim, int delim_size)
+{
+	memset(f, 0, sizeof *f);
+	if(delim == NULL || delim_size < 1 || buf_size <= delim_size)
+	{
+		return -1;
+	}
+	if((f->buf = (char*)malloc(buf_size)) == NULL)
+	{
+		return -2;
+	}
+	f->buf_size = buf_size;
+	f->mode = TFRAMER_DELIM;
+	f->delim = delim;
+	f->delim_size = delim_size;
+	return 0;
+}
+
+
+#define TFRAMER_CREATE_CUSTOM_ERRS (2)
+#define TFRAMER_CREATE_CUSTOM_ERR_ARG (-1)
+#define TFRAMER_CREATE_CUSTOM_ERR_ARG_STR "Invalid framing parameters"
+#define TFRAMER_CREATE_CUSTOM_ERR_MEM (-2)
+#define TFRAMER_CREATE_CUSTOM_ERR_MEM_STR "Unable to allocate buffer"
+
+#define TFRAMER_CREATE_CUSTOM_ERR__STR(err) ((err == TFRAMER_CREATE_CUSTOM_ERR_ARG) ? TFRAMER_CREATE_CUSTOM_ERR_ARG_STR : (err == TFRAMER_CREATE_CUSTOM_ERR_MEM) ? TFRAMER_CREATE_CUSTOM_ERR_MEM_STR : "")
+
+/**
+ * Sets up a framer whose messages are delimited by a callback (e.g. HTTP responses, RESP replies).
+ * The frames handed out by tframer_next are the whole messages as measured by [cb].
+ * 
+ * struct tframer *f: Pointer to the framer to initialize
+ * int buf_size:      Size of the internal buffer. Bounds the size of a single message.
+ * tframer_cb cb:     Callback measuring the message at the start of the buffered data
+ * void *arg:         Pointer handed to [cb] untouched
+ * 
+ * return:            Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Invalid framing parameters => -1
+ *  Unable to allocate buffer =>  -2
+ */
+int tframer_create_custom(struct tframer *f, int buf_size, tframer_cb cb, void *arg)
+{
+	memset(f, 0, sizeof *f);
+	if(cb == NULL || buf_size < 1)
+	{
+		return -1;
+	}
+	if((f->buf = (char*)malloc(buf_size)) == NULL)
+	{
+		return -2;
+	}
+	f->buf_size = buf_size;
+	f->mode = TFRAMER_CUSTOM;
+	f->frame_cb = cb;
+	f->frame_arg = arg;
+	return 0;
+}
+
+
+#define TFRAMER_FILL_ERRS (3)
+#define TFRAMER_FILL_ERR_NODATA (-1)
+#define TFRAMER_FILL_ERR_NODATA_STR "Target disconnected"
+#define TFRAMER_FILL_ERR_RECV (-2)
+#define TFRAMER_FILL_ERR_RECV_STR "Unable to receive data"
+#define TFRAMER_FILL_ERR_FULL (-3)
+#define TFRAMER_FILL_ERR_FULL_STR "Message does not fit into buffer"
+
+#define TFRAMER_FILL_ERR__STR(err) ((err == TFRAMER_FILL_ERR_NODATA) ? TFRAMER_FILL_ERR_NODATA_STR : (err == TFRAMER_FILL_ERR_RECV) ? TFRAMER_FILL_ERR_RECV_STR : (err == TFRAMER_FILL_ERR_FULL) ? TFRAMER_FILL_ERR_FULL_STR : "")
+
+/**
+ * Receives as much data as fits into the framer's buffer with a single recv.
+ * Invalidates frames handed out by tframer_next before.
+ * 
+ * struct tframer *f: Framer to fill
+ * int targetfd:      UNIX file descriptor of target (With TCP connection established)
+ * 
+ * return:            Returns number of bytes received (0 if a non-blocking socket had no data) and error code upon failure
+ * 
+ * {error codes}:
+ *  Target disconnected =>              -1
+ *  Unable to receive data =>           -2
+ *  Message does not fit into buffer => -3
+ */
+int tframer_fill(struct tframer *f, int targetfd)
+{
+	ssize_t received;
+	
+	if(f->start == f->end)
+	{
+		f->start = f->end = f->scan = 0;
+	}
+	else if(f->end == f->buf_size)
+	{
+		if(f->start == 0)
+		{
+			return -3;
+		}
+		// Move the incomplete message to the front to make room
+		memmove(f->buf, f->buf + f->start, f->end - f->start);
+		f->end -= f->start;
+		f->scan -= f->start;
+		f->start = 0;
+	}
+	
+	do
+	{
+		received = recv(targetfd, f->buf + f->end, f->buf_size - f->end, 0);
+	}while(received == -1 && errno == EINTR);
+	if(received == -1)
+	{
+		return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -2;
+	}
+	if(received == 0)
+	{
+		return -1;
+	}
+	f->end += (int)received;
+	return (int)received;
+}
+
+
+#define TFRAMER_NEXT_ERRS (1)
+#define TFRAMER_NEXT_ERR_SIZE (-1)
+#define TFRAMER_NEXT_ERR_SIZE_STR "Message does not fit into buffer"
+
+#define TFRAMER_NEXT_ERR__STR(err) ((err == TFRAMER_NEXT_ERR_SIZE) ? TFRAMER_NEXT_ERR_SIZE_STR : "")
+
+/**
+ * Takes the next complete message out of the framer's buffer.
+ * With custom framing, data rejected by the callback is reported as -1 as well.
+ * 
+ * struct tframer *f: Framer to take the message from
+ * char **frame:      Will be set to the start of the message (without prefix / delimiter)
+ * int *frame_size:   Will be set to the size of the message
+ * 
+ * return:            Returns 1 if a message was taken, 0 if more data is needed and error code upon failure
+ * 
+ * {error codes}:
+ *  Message does not fit into buffer => -1
+ */
+int tframer_next(struct tframer *f, char **frame, int *frame_size)
+{
+	int available = f->end - f->start;
+	
+	if(f->mode == TFRAMER_LENGTH)
+	{
+		const unsigned char *p = (const unsigned char*)f->buf + f->start;
+		unsigned int length = 0;
+		int i;
+		
+		if(available < f->prefix_size) return 0;
+		for(i = 0; i < f->prefix_size; i++)
+		{
+			length = (length << 8) | p[i];
+		}
+		if(length > (unsigned int)(f->buf_size - f->prefix_size))
+		{
+			return -1;
+		}
+		if((unsigned int)(available - f->prefix_size) < length) return 0;
+		*frame = f->buf + f->start + f->prefix_size;
+		*frame_size = (int)length;
+		f->start += f->prefix_size + (int)length;
+		return 1;
+	}
+	else if(f->mode == TFRAMER_CUSTOM)
+	{
+		int length = (available > 0) ? f->frame_cb(f->buf + f->start, available, f->frame_arg) : 0;
+		
+		if(length < 0 || length > f->buf_size)
+		{
+			return -1;
+		}
+		if(length == 0 || length > available)
+		{
+			if(f->start == 0 && f->end == f->buf_size) return -1;
+			return 0;
+		}
+		*frame = f->buf + f->start;
+		*frame_size = length;
+		f->start += length;
+		return 1;
+	}
+	else
+	{
+		char *found;
+		
+		if(f->scan < f->start) f->scan = f->start;
+		found = (char*)memmem(f->buf + f->scan, f->end - f->scan, f->delim, f->delim_size);
+		if(found == NULL)
+		{
+			// Resume searching where a partially received delimiter could start
+			f->scan = f->end - f->delim_size + 1;
+			if(f->start == 0 && f->end == f->buf_size) return -1;
+			return 0;
+		}
+		*frame = f->buf + f->start;
+		*frame_size = (int)(found - *frame);
+		f->start = (int)(found - f->buf) + f->delim_size;
+		f->scan = f->start;
+		return 1;
+	}
+}
+
+#define TFRAMER_DESTROY_ERRS (0)
+#define TFRAMER_DESTROY_ERR__STR(err) ""
+
+/**
+ * Frees the framer's buffer.
+ * 
+ */
+void tframer_destroy(struct tframer *f)
+{
+	free(f->buf);
+	f->buf = NULL;
+}
+
+
+/*
+Mirrored ring buffer:
+	A receive ring whose pages are mapped twice, back to back, so the readable (and the writable) region is
+	always contiguous in memory, even when it wraps around the end of the ring. Parsers work in place on
+	the received bytes, no message ever needs to be moved or copied to a temporary buffer:
+		while(tring_fill(&r, fd) > 0)
+		{
+			size = tring_peek(&r, &data);
+			while((n = parse(data, size)) > 0) { tring_consume(&r, n); size = tring_peek(&r, &data); }
+		}
+	The size is rounded up to a multiple of the page size.
+*/
+
+struct tring
+{
+	char *buf;
+	size_t size;
+	size_t head;
+	size_t tail;
+};
+
+
+#define TRING_CREATE_ERRS (2)
+#define TRING_CREATE_ERR_MEMFD (-1)
+#define TRING_CREATE_ERR_MEMFD_STR "Unable to set up memory file"
+#define TRING_CREATE_ERR_MAP (-2)
+#define TRING_CREATE_ERR_MAP_STR "Unable to map ring"
+
+#define TRING_CREATE_ERR__STR(err) ((err == TRING_CREATE_ERR_MEMFD) ? TRING_CREATE_ERR_MEMFD_STR : (err == TRING_CREATE_ERR_MAP) ? TRING_CREATE_ERR_MAP_STR : "")
+
+/**
+ * Sets up a mirrored ring buffer.
+ * 
+ * struct tring *r: Pointer to the ring to initialize
+ * size_t size:     Capacity of the ring in bytes (rounded up to a multiple of the page size)
+ * 
+ * return:          Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to set up memory file => -1
+ *  Unable to map ring =>           -2
+ */
+int tring_create(struct tring *r, size_t size)
+{
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	char *base;
+	int memfd;
+	
+	memset(r, 0, sizeof *r);
+	size = (size + page - 1) / page * page;
+	if(size == 0) size = page;
+	if((memfd = memfd_create("netlib-ring", MFD_CLOEXEC)) == -1)
+	{
+		return -1;
+	}
+	if(ftruncate(memfd, size) == -1)
+	{
+		close(memfd);
+		return -1;
+	}
+	
+	// Reserve both halves at once, then put the same pages into each of them
+	if((base = (char*)mmap(NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+	{
+		close(memfd);
+		return -2;
+	}
+	if(mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, memfd, 0) == MAP_FAILED ||
+		mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, memfd, 0) == MAP_FAILED)
+	{
+		munmap(base, 2 * size);
+		close(memfd);
+		return -2;
+	}
+	// The mappings keep the memory alive
+	close(memfd);
+	r->buf = base;
+	r->size = size;
+	return 0;
+}
+
+#define TRING_PEEK_ERRS (0)
+#define TRING_PEEK_ERR__STR(err) ""
+
+/**
+ * Gets the readable region of the ring, which is always contiguous.
+ * 
+ * struct tring *r: Ring to read from
+ * char **data:     Will be set to the first readable byte
+ * 
+ * return:          Returns number of readable bytes
+ */
+size_t tring_peek(struct tring *r, char **data)
+{
+	*data = r->buf + r->head;
+	return r->tail - r->head;
+}
+
+#define TRING_CONSUME_ERRS (0)
+#define TRING_CONSUME_ERR__STR(err) ""
+
+/**
+ * Marks [n] readable bytes as consumed (at most the number returned by tring_peek).
+ * 
+ */
+void tring_consume(struct tring *r, size_t n)
+{
+	r->head += n;
+	// Keep both positions inside the first mapping
+	if(r->head >= r->size)
+	{
+		r->head -= r->size;
+		r->tail -= r->size;
+	}
+}
+
+#define TRING_RESERVE_ERRS (0)
+#define TRING_RESERVE_ERR__STR(err) ""
+
+/**
+ * Gets the writable region of the ring, which is always contiguous. Fill it and call tring_commit (e.g. to read from a file).
+ * 
+ * struct tring *r: Ring to write to
+ * char **data:     Will be set to the first writable byte
+ * 
+ * return:          Returns number of writable bytes
+ */
+size_t tring_reserve(struct tring *r, char **data)
+{
+	*data = r->buf + r->tail;
+	return r->size - (r->tail - r->head);
+}
+
+#define TRING_COMMIT_ERRS (0)
+#define TRING_COMMIT_ERR__STR(err) ""
+
+/**
+ * Marks [n] bytes written to the region returned by tring_reserve as readable.
+ * 
+ */
+void tring_commit(struct tring *r, size_t n)
+{
+	r->tail += n;
+}
+
+
+#define TRING_FILL_ERRS (3)
+#define TRING_FILL_ERR_NODATA (-1)
+#define TRING_FILL_ERR_NODATA_STR "Target disconnected"
+#define TRING_FILL_ERR_RECV (-2)
+#define TRING_FILL_ERR_RECV_STR "Unable to receive data"
+#define TRING_FILL_ERR_FULL (-3)
+#define TRING_FILL_ERR_FULL_STR "Ring is full"
+
+#define TRING_FILL_ERR__STR(err) ((err == TRING_FILL_ERR_NODATA) ? TRING_FILL_ERR_NODATA_STR : (err == TRING_FILL_ERR_RECV) ? TRING_FILL_ERR_RECV_STR : (err == TRING_FILL_ERR_FULL) ? TRING_FILL_ERR_FULL_STR : "")
+
+/**
+ * Receives as much data as fits into the ring with a single recv. Never moves data already in the ring.
+ * 
+ * struct tring *r: Ring to fill
+ * int targetfd:    UNIX file descriptor of target (With TCP connection established)
+ * 
+ * return:          Returns number of bytes received (0 if a non-blocking socket had no data) and error code upon failure
+ * 
+ * {error codes}:
+ *  Target disconnected =>    -1
+ *  Unable to receive data => -2
+ *  Ring is full =>           -3
+ */
+int tring_fill(struct tring *r, int targetfd)
+{
+	char *data;
+	size_t space = tring_reserve(r, &data);
+	ssize_t received;
+	
+	if(space == 0)
+	{
+		return -3;
+	}
+	if(space > INT_MAX) space = INT_MAX;
+	do
+	{
+		received = recv(targetfd, data, space, 0);
+	}while(received == -1 && errno == EINTR);
+	if(received == -1)
+	{
+		return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -2;
+	}
+	if(received == 0)
+	{
+		return -1;
+	}
+	tring_commit(r, (size_t)received);
+	return (int)received;
+}
+
+#define TRING_DESTROY_ERRS (0)
+#define TRING_DESTROY_ERR__STR(err) ""
+
+/**
+ * Unmaps the ring.
+ * 
+ */
+void tring_destroy(struct tring *r)
+{
+	if(r->buf != NULL) munmap(r->buf, 2 * r->size);
+	r->buf = NULL;
+	r->size = r->head = r->tail = 0;
+}
+
+/*
+Pipelining:
+	Keeps up to [window] requests in flight on one connection instead of waiting a full round trip for each
+	reply as tsend_recv does. Responses are split by a framing callback (see tframer_create_custom) and matched
+	to the requests in FIFO order, which is what pipelining protocols (HTTP/1.1, Redis, memcached, ...) guarantee:
+		tpipe_create(&p, fd, 64, 65536, resp_size, NULL);
+		for(...) tpipe_submit(&p, &reqs[i]);
+		tpipe_flush(&p);
+	Requests are linked into the queue, they must stay valid until their [done] callback was invoked.
+	Responses are only valid during that callback.
+*/
+
+struct tpipe_req
+{
+	char *bytes;
+	int bytes_size;
+	void (*done)(struct tpipe_req *req, char *resp, int resp_size);
+	void *user;
+	struct tpipe_req *next;
+};
+
+struct tpipe
+{
+	int fd;
+	int window;
+	int outstanding;
+	struct tpipe_req *head;
+	struct tpipe_req *tail;
+	struct tframer f;
+};
+
+
+#define TPIPE_CREATE_ERRS (2)
+#define TPIPE_CREATE_ERR_ARG (-1)
+#define TPIPE_CREATE_ERR_ARG_STR "Invalid pipelining parameters"
+#define TPIPE_CREATE_ERR_MEM (-2)
+#define TPIPE_CREATE_ERR_MEM_STR "Unable to allocate buffer"
+
+#define TPIPE_CREATE_ERR__STR(err) ((err == TPIPE_CREATE_ERR_ARG) ? TPIPE_CREATE_ERR_ARG_STR : (err == TPIPE_CREATE_ERR_MEM) ? TPIPE_CREATE_ERR_MEM_STR : "")
+
+/**
+ * Sets up a pipelined client on an established connection.
+ * 
+ * struct tpipe *p: Pointer to the pipelined client to initialize
+ * int targetfd:    UNIX file descriptor of target (With TCP connection established)
+ * int window:      Maximum number of requests in flight
+ * int buf_size:    Size of the receive buffer. Bounds the size of a single response.
+ * tframer_cb cb:   Callback measuring the response at the start of the received data
+ * void *arg:       Pointer handed to [cb] untouched
+ * 
+ * return:          Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Invalid pipelining parameters => -1
+ *  Unable to allocate buffer =>     -2
+ */
+int tpipe_create(struct tpipe *p, int targetfd, int window, int buf_size, tframer_cb cb, void *arg)
+{
+	int ret;
+	
+	memset(p, 0, sizeof *p);
+	if(window < 1)
+	{
+		return -1;
+	}
+	if((ret = tframer_create_custom(&p->f, buf_size, cb, arg)) < 0)
+	{
+		return ret;
+	}
+	p->fd = targetfd;
+	p->window = window;
+	return 0;
+}
+
+/* Completes the oldest request if its response is available (waiting for it if [wait]). Returns 1 if completed, 0 if not and the error codes of tpipe_flush upon failure */
+static int tpipe__complete(struct tpipe *p, int wait)
+{
+	struct tpipe_req *req;
+	char *frame;
+	int frame_size, ret;
+	
+	for(;;)
+	{
+		if((ret = tframer_next(&p->f, &frame, &frame_size)) < 0)
+		{
+			return -3;
+		}
+		if(ret == 1)
+		{
+			if((req = p->head) == NULL)
+			{
+				// A response nobody asked for
+				return -3;
+			}
+			if((p->head = req->next) == NULL) p->tail = NULL;
+			p->outstanding--;
+			if(req->done != NULL) req->done(req, frame, frame_size);
+			return 1;
+		}
+		if(!wait && netlib__poll(p->fd, POLLIN, 0) != 1)
+		{
+			return 0;
+		}
+		if((ret = tframer_fill(&p->f, p->fd)) < 0)
+		{
+			// Disconnected, unable to receive and oversized map onto the same codes
+			return ret;
+		}
+		if(ret == 0 && (!wait || netlib__poll(p->fd, POLLIN, -1) == -1))
+		{
+			return wait ? -2 : 0;
+		}
+	}
+}
+
+
+#define TPIPE_SUBMIT_ERRS (4)
+#define TPIPE_SUBMIT_ERR_SEND (-1)
+#define TPIPE_SUBMIT_ERR_SEND_STR "Unable to send data"
+#define TPIPE_SUBMIT_ERR_NODATA (-2)
+#define TPIPE_SUBMIT_ERR_NODATA_STR "Target disconnected"
+#define TPIPE_SUBMIT_ERR_RECV (-3)
+#define TPIPE_SUBMIT_ERR_RECV_STR "Unable to receive data"
+#define TPIPE_SUBMIT_ERR_FRAME (-4)
+#define TPIPE_SUBMIT_ERR_FRAME_STR "Invalid or oversized response"
+
+#define TPIPE_SUBMIT_ERR__STR(err) ((err == TPIPE_SUBMIT_ERR_SEND) ? TPIPE_SUBMIT_ERR_SEND_STR : (err == TPIPE_SUBMIT_ERR_NODATA) ? TPIPE_SUBMIT_ERR_NODATA_STR : (err == TPIPE_SUBMIT_ERR_RECV) ? TPIPE_SUBMIT_ERR_RECV_STR : (err == TPIPE_SUBMIT_ERR_FRAME) ? TPIPE_SUBMIT_ERR_FRAME_STR : "")
+
+/**
+ * Sends a request without waiting for its response. If the window is full, waits for the oldest responses first.
+ * Responses which already arrived are completed along the way. The request is sent without blocking: while the
+ * socket buffer is full, responses keep being read, so a peer stalled on writing them can't deadlock the pipeline.
+ * 
+ * struct tpipe *p:       Pipelined client to send over
+ * struct tpipe_req *req: Request with [bytes], [bytes_size] and [done] set
+ * 
+ * return:                Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to send data =>           -1
+ *  Target disconnected =>           -2
+ *  Unable to receive data =>        -3
+ *  Invalid or oversized response => -4
+ */
+int tpipe_submit(struct tpipe *p, struct tpipe_req *req)
+{
+	struct pollfd pfd;
+	char *pos = req->bytes;
+	int left = req->bytes_size;
+	ssize_t sent;
+	int ret;
+	
+	// tpipe__complete fails with the codes of tpipe_flush, which are one off from ours
+	while(p->outstanding >= p->window)
+	{
+		if((ret = tpipe__complete(p, 1)) < 0)
+		{
+			return ret - 1;
+		}
+	}
+	while(left > 0)
+	{
+		sent = send(p->fd, pos, left, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if(sent > 0)
+		{
+			pos += sent;
+			left -= (int)sent;
+			continue;
+		}
+		if(sent == -1 && errno == EINTR) continue;
+		if(sent == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+		{
+			return -1;
+		}
+		// Socket buffer full: the peer may be blocked sending responses nobody reads yet, so drain them while waiting
+		pfd.fd = p->fd;
+		pfd.events = POLLIN | POLLOUT;
+		pfd.revents = 0;
+		if(poll(&pfd, 1, -1) == -1)
+		{
+			if(errno == EINTR) continue;
+			return -1;
+		}
+		if(pfd.revents & POLLIN)
+		{
+			while((ret = tpipe__complete(p, 0)) == 1);
+			if(ret < 0)
+			{
+				return ret - 1;
+			}
+		}
+	}
+	req->next = NULL;
+	if(p->tail != NULL) p->tail->next = req;
+	else p->head = req;
+	p->tail = req;
+	p->outstanding++;
+	
+	while((ret = tpipe__complete(p, 0)) == 1);
+	return (ret < 0) ? ret - 1 : 0;
+}
+
+
+#define TPIPE_FLUSH_ERRS (3)
+#define TPIPE_FLUSH_ERR_NODATA (-1)
+#define TPIPE_FLUSH_ERR_NODATA_STR "Target disconnected"
+#define TPIPE_FLUSH_ERR_RECV (-2)
+#define TPIPE_FLUSH_ERR_RECV_STR "Unable to receive data"
+#define TPIPE_FLUSH_ERR_FRAME (-3)
+#define TPIPE_FLUSH_ERR_FRAME_STR "Invalid or oversized response"
+
+#define TPIPE_FLUSH_ERR__STR(err) ((err == TPIPE_FLUSH_ERR_NODATA) ? TPIPE_FLUSH_ERR_NODATA_STR : (err == TPIPE_FLUSH_ERR_RECV) ? TPIPE_FLUSH_ERR_RECV_STR : (err == TPIPE_FLUSH_ERR_FRAME) ? TPIPE_FLUSH_ERR_FRAME_STR : "")
+
+/**
+ * Waits until all requests in flight were completed.
+ * 
+ * struct tpipe *p: Pipelined client to wait on
+ * 
+ * return:          Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Target disconnected =>           -1
+ *  Unable to receive data =>        -2
+ *  Invalid or oversized response => -3
+ */
+int tpipe_flush(struct tpipe *p)
+{
+	int ret;
+	
+	while(p->outstanding > 0)
+	{
+		if((ret = tpipe__complete(p, 1)) < 0)
+		{
+			return ret;
+		}
+	}
+	return 0;
+}
+
+#define TPIPE_DESTROY_ERRS (0)
+#define TPIPE_DESTROY_ERR__STR(err) ""
+
+/**
+ * Frees the pipelined client. Requests still in flight are dropped without invoking their callbacks. Does not close the connection.
+ * 
+ */
+void tpipe_destroy(struct tpipe *p)
+{
+	tframer_destroy(&p->f);
+	p->head = p->tail = NULL;
+	p->outstanding = 0;
+}
+
+
+/*
+Multiplexed RPC:
+	Runs any number of concurrent calls over one TCP connection, answered in any order, so a slow call
+	doesn't hold up the others. Every frame starts with a 12 byte header (big endian):
+		uint32 id | uint16 flags | uint16 reserved | uint32 payload length
+	A channel owns one reader thread (dispatching responses to their calls via the completion table and
+	requests to [on_request]) and one writer thread sending all queued frames with as few tsendv calls as possible.
+	Both ends of a connection use the same channel, a side that only makes calls passes NULL as [on_request]:
+		call.req = ...; call.req_size = ...; call.done = on_done;
+		trpc_request(&c, &call);
+		on_request(c, id, data, size, arg) { trpc_reply(c, id, 0, result, result_size); }
+	Callbacks run on the reader thread and must not block for long. Calls are linked into the channel and must stay
+	valid until their [done] callback was invoked, which happens exactly once (with a negative status if the channel failed).
+*/
+
+#define TRPC_HEADER_SIZE (12)
+#define TRPC_BUCKETS (4096)
+#define TRPC_WRITE_BATCH (64)
+
+#define TRPC_REQUEST (1)
+#define TRPC_RESPONSE (2)
+#define TRPC_ERROR (4)
+
+struct trpc;
+
+struct trpc_out
+{
+	struct trpc_out *next;
+	unsigned char header[TRPC_HEADER_SIZE];
+	const char *data;
+	int size;
+	int owned;
+};
+
+struct trpc_call
+{
+	struct trpc_out out;
+	uint32_t id;
+	const char *req;
+	int req_size;
+	void (*done)(struct trpc_call *call, int status, char *resp, int resp_size);
+	void *user;
+	struct trpc_call *next;
+};
+
+typedef void (*trpc_request_cb)(struct trpc *c, uint32_t id, char *data, int size, void *arg);
+
+struct trpc
+{
+	int fd;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	struct trpc_call *table[TRPC_BUCKETS];
+	uint32_t next_id;
+	struct trpc_out *out_head;
+	struct trpc_out *out_tail;
+	int closed;
+	int status;
+	int writer_done;
+	struct tframer f;
+	trpc_request_cb on_request;
+	void *arg;
+	pthread_t reader;
+	pthread_t writer;
+};
+
+static void trpc__header(unsigned char *h, uint32_t id, uint16_t flags, uint32_t size)
+{
+	uint32_t v;
+	uint16_t w = htons(flags);
+	
+	v = htonl(id);
+	memcpy(h, &v, 4);
+	memcpy(h + 4, &w, 2);
+	memset(h + 6, 0, 2);
+	v = htonl(size);
+	memcpy(h + 8, &v, 4);
+}
+
+static int trpc__frame_size(const char *data, int size, void *arg)
+{
+	uint32_t length;
+	
+	(void)arg;
+	if(size < TRPC_HEADER_SIZE) return 0;
+	memcpy(&length, data + 8, 4);
+	length = ntohl(length);
+	if(length > INT_MAX - TRPC_HEADER_SIZE) return -1;
+	return TRPC_HEADER_SIZE + (int)length;
+}
+
+/* Queues a frame for the writer. Must be called with the lock held. */
+static void trpc__queue(struct trpc *c, struct trpc_out *o)
+{
+	o->next = NULL;
+	if(c->out_tail != NULL) c->out_tail->next = o;
+	else c->out_head = o;
+	c->out_tail = o;
+	pthread_cond_signal(&c->wake);
+}
+
+/* Marks the channel as closed (the first [status] wins) and wakes up both threads */
+static void trpc__close(struct trpc *c, int status)
+{
+	pthread_mutex_lock(&c->lock);
+	if(!c->closed)
+	{
+		c->closed = 1;
+		c->status = status;
+	}
+	pthread_cond_broadcast(&c->wake);
+	pthread_mutex_unlock(&c->lock);
+	// Wakes up a thread blocked on the socket
+	shutdown(c->fd, SHUT_RDWR);
+}
+
+/* Completes all calls still waiting for a response. Waits for the writer to exit first, until then it may still read queued calls. */
+static void trpc__fail(struct trpc *c)
+{
+	struct trpc_call *failed = NULL, *call, *next;
+	struct trpc_out *o, *next_out;
+	int i;
+	
+	pthread_mutex_lock(&c->lock);
+	while(!c->writer_done)
+	{
+		pthread_cond_wait(&c->wake, &c->lock);
+	}
+	// Frames the writer never took: calls among them are in the table and completed below
+	for(o = c->out_head; o != NULL; o = next_out)
+	{
+		next_out = o->next;
+		if(o->owned) free(o);
+	}
+	c->out_head = c->out_tail = NULL;
+	for(i = 0; i < TRPC_BUCKETS; i++)
+	{
+		for(call = c->table[i]; call != NULL; call = next)
+		{
+			next = call->next;
+			call->next = failed;
+			failed = call;
+		}
+		c->table[i] = NULL;
+	}
+	pthread_mutex_unlock(&c->lock);
+	
+	for(call = failed; call != NULL; call = next)
+	{
+		next = call->next;
+		if(call->done != NULL) call->done(call, c->status, NULL, 0);
+	}
+}
+
+static void *trpc__reader(void *arg)
+{
+	struct trpc *c = (struct trpc*)arg;
+	struct trpc_call **link, *call;
+	char *frame;
+	int frame_size, ret;
+	uint32_t id;
+	uint16_t flags;
+	
+	for(;;)
+	{
+		if((ret = tframer_next(&c->f, &frame, &frame_size)) < 0)
+		{
+			break;
+		}
+		if(ret == 0)
+		{
+			if(tframer_fill(&c->f, c->fd) < 0) break;
+			continue;
+		}
+		
+		memcpy(&id, frame, 4);
+		memcpy(&flags, frame + 4, 2);
+		id = ntohl(id);
+		flags = ntohs(flags);
+		if(flags & TRPC_REQUEST)
+		{
+			if(c->on_request != NULL) c->on_request(c, id, frame + TRPC_HEADER_SIZE, frame_size - TRPC_HEADER_SIZE, c->arg);
+			continue;
+		}
+		
+		pthread_mutex_lock(&c->lock);
+		for(link = &c->table[id % TRPC_BUCKETS]; *link != NULL && (*link)->id != id; link = &(*link)->next);
+		if((call = *link) != NULL) *link = call->next;
+		pthread_mutex_unlock(&c->lock);
+		// Responses to unknown ids (e.g. answered twice) are dropped
+		if(call != NULL && call->done != NULL)
+		{
+			call->done(call, (flags & TRPC_ERROR) ? -1 : 0, frame + TRPC_HEADER_SIZE, frame_size - TRPC_HEADER_SIZE);
+		}
+	}
+	trpc__close(c, -2);
+	trpc__fail(c);
+	return NULL;
+}
+
+static void *trpc__writer(void *arg)
+{
+	struct trpc *c = (struct trpc*)arg;
+	struct iovec iov[2 * TRPC_WRITE_BATCH];
+	struct trpc_out *list, *next, *owned[TRPC_WRITE_BATCH];
+	int n, n_owned, i;
+	
+	for(;;)
+	{
+		pthread_mutex_lock(&c->lock);
+		while(c->out_head == NULL && !c->closed)
+		{
+			pthread_cond_wait(&c->wake, &c->lock);
+		}
+		if(c->closed)
+		{
+			pthread_mutex_unlock(&c->lock);
+			break;
+		}
+		list = c->out_head;
+		c->out_head = c->out_tail = NULL;
+		pthread_mutex_unlock(&c->lock);
+		
+		while(list != NULL)
+		{
+			// Everything needed from a call is read before sending: once sent, its response may complete and free it
+			for(n = n_owned = 0; list != NULL && n < TRPC_WRITE_BATCH; n++, list = list->next)
+			{
+				iov[2 * n].iov_base = list->header;
+				iov[2 * n].iov_len = TRPC_HEADER_SIZE;
+				iov[2 * n + 1].iov_base = (void*)list->data;
+				iov[2 * n + 1].iov_len = list->size;
+				if(list->owned) owned[n_owned++] = list;
+			}
+			if(tsendv(c->fd, iov, 2 * n, NULL) < 0)
+			{
+				// Calls left in the batch are completed by the reader once this thread is done
+				for(i = 0; i < n_owned; i++) free(owned[i]);
+				for(; list != NULL; list = next)
+				{
+					next = list->next;
+					if(list->owned) free(list);
+				}
+				trpc__close(c, -4);
+				break;
+			}
+			for(i = 0; i < n_owned; i++) free(owned[i]);
+		}
+	}
+	pthread_mutex_lock(&c->lock);
+	c->writer_done = 1;
+	pthread_cond_broadcast(&c->wake);
+	pthread_mutex_unlock(&c->lock);
+	return NULL;
+}
+
+
+#define TRPC_START_ERRS (2)
+#define TRPC_START_ERR_MEM (-1)
+#define TRPC_START_ERR_MEM_STR "Unable to allocate buffer"
+#define TRPC_START_ERR_THREAD (-2)
+#define TRPC_START_ERR_THREAD_STR "Unable to start reader or writer thread"
+
+#define TRPC_START_ERR__STR(err) ((err == TRPC_START_ERR_MEM) ? TRPC_START_ERR_MEM_STR : (err == TRPC_START_ERR_THREAD) ? TRPC_START_ERR_THREAD_STR : "")
+
+/**
+ * Starts an RPC channel on an established connection.
+ * 
+ * struct trpc *c:             Pointer to the channel to initialize
+ * int targetfd:               UNIX file descriptor of target (With TCP connection established)
+ * int max_frame:              Largest payload which can be received
+ * trpc_request_cb on_request: Callback invoked for incoming requests (may be NULL)
+ * void *arg:                  Pointer handed to [on_request] untouched
+ * 
+ * return:                     Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to allocate buffer =>               -1
+ *  Unable to start reader or writer thread => -2
+ */
+int trpc_start(struct trpc *c, int targetfd, int max_frame, trpc_request_cb on_request, void *arg)
+{
+	memset(c, 0, sizeof *c);
+	c->fd = targetfd;
+	c->on_request = on_request;
+	c->arg = arg;
+	c->next_id = 1;
+	if(max_frame < 0 || max_frame > INT_MAX - TRPC_HEADER_SIZE || tframer_create_custom(&c->f, TRPC_HEADER_SIZE + max_frame, trpc__frame_size, NULL) < 0)
+	{
+		return -1;
+	}
+	pthread_mutex_init(&c->lock, NULL);
+	pthread_cond_init(&c->wake, NULL);
+	if(pthread_create(&c->reader, NULL, trpc__reader, c) != 0)
+	{
+		tframer_destroy(&c->f);
+		pthread_mutex_destroy(&c->lock);
+		pthread_cond_destroy(&c->wake);
+		return -2;
+	}
+	if(pthread_create(&c->writer, NULL, trpc__writer, c) != 0)
+	{
+		pthread_mutex_lock(&c->lock);
+		c->writer_done = 1;
+		pthread_mutex_unlock(&c->lock);
+		trpc__close(c, -4);
+		pthread_join(c->reader, NULL);
+		tframer_destroy(&c->f);
+		pthread_mutex_destroy(&c->lock);
+		pthread_cond_destroy(&c->wake);
+		return -2;
+	}
+	return 0;
+}
+
+
+#define TRPC_REQUEST_ERRS (1)
+#define TRPC_REQUEST_ERR_CLOSED (-1)
+#define TRPC_REQUEST_ERR_CLOSED_STR "Channel is closed"
+
+#define TRPC_REQUEST_ERR__STR(err) ((err == TRPC_REQUEST_ERR_CLOSED) ? TRPC_REQUEST_ERR_CLOSED_STR : "")
+
+/**
+ * Starts a call. Thread safe, never blocks. [call->done] is invoked on the reader thread with status 0 and the response,
+ * -1 if the other side answered with TRPC_ERROR or below -1 if the channel failed before the response arrived:
+ * -2 if receiving failed or the other side disconnected, -3 if the channel was stopped and -4 if sending failed.
+ * 
+ * struct trpc *c:         Channel to call over
+ * struct trpc_call *call: Call with [req], [req_size] and [done] set. [call->id] is set by this function.
+ * 
+ * return:                 Returns 0 upon success and error code upon failure ([done] is not invoked then)
+ * 
+ * {error codes}:
+ *  Channel is closed => -1
+ */
+int trpc_request(struct trpc *c, struct trpc_call *call)
+{
+	struct trpc_call **bucket;
+	
+	pthread_mutex_lock(&c->lock);
+	if(c->closed)
+	{
+		pthread_mutex_unlock(&c->lock);
+		return -1;
+	}
+	call->id = c->next_id++;
+	trpc__header(call->out.header, call->id, TRPC_REQUEST, (uint32_t)call->req_size);
+	call->out.data = call->req;
+	call->out.size = call->req_size;
+	call->out.owned = 0;
+	bucket = &c->table[call->id % TRPC_BUCKETS];
+	call->next = *bucket;
+	*bucket = call;
+	trpc__queue(c, &call->out);
+	pthread_mutex_unlock(&c->lock);
+	return 0;
+}
+
+
+#define TRPC_REPLY_ERRS (2)
+#define TRPC_REPLY_ERR_CLOSED (-1)
+#define TRPC_REPLY_ERR_CLOSED_STR "Channel is closed"
+#define TRPC_REPLY_ERR_MEM (-2)
+#define TRPC_REPLY_ERR_MEM_STR "Unable to allocate memory"
+
+#define TRPC_REPLY_ERR__STR(err) ((err == TRPC_REPLY_ERR_CLOSED) ? TRPC_REPLY_ERR_CLOSED_STR : (err == TRPC_REPLY_ERR_MEM) ? TRPC_REPLY_ERR_MEM_STR : "")
+
+/**
+ * Answers an incoming request. Thread safe, never blocks, [data] is copied.
+ * 
+ * struct trpc *c:   Channel the request came in on
+ * uint32_t id:      Id handed to [on_request]
+ * int error:        Non-zero to mark the response as an error (TRPC_ERROR)
+ * const char *data: Response payload
+ * int size:         Size of [data]
+ * 
+ * return:           Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Channel is closed =>         -1
+ *  Unable to allocate memory => -2
+ */
+int trpc_reply(struct trpc *c, uint32_t id, int error, const char *data, int size)
+{
+	struct trpc_out *o;
+	
+	if((o = (struct trpc_out*)malloc(sizeof *o + size)) == NULL)
+	{
+		return -2;
+	}
+	memcpy(o + 1, data, size);
+	trpc__header(o->header, id, TRPC_RESPONSE | (error ? TRPC_ERROR : 0), (uint32_t)size);
+	o->data = (const char*)(o + 1);
+	o->size = size;
+	o->owned = 1;
+	pthread_mutex_lock(&c->lock);
+	if(c->closed)
+	{
+		pthread_mutex_unlock(&c->lock);
+		free(o);
+		return -1;
+	}
+	trpc__queue(c, o);
+	pthread_mutex_unlock(&c->lock);
+	return 0;
+}
+
+#define TRPC_STOP_ERRS (0)
+#define TRPC_STOP_ERR__STR(err) ""
+
+/**
+ * Stops the channel: calls still waiting are completed with a negative status, both threads are joined.
+ * Must not be called from a callback. Does not close the connection (but shuts it down).
+ * 
+ */
+void trpc_stop(struct trpc *c)
+{
+	// The reader completes the remaining calls after the writer exited
+	trpc__close(c, -3);
+	pthread_join(c->reader, NULL);
+	pthread_join(c->writer, NULL);
+	tframer_destroy(&c->f);
+	pthread_mutex_destroy(&c->lock);
+	pthread_cond_destroy(&c->wake);
+}
+
+
+/*
+Buffer pool:
+	Fixed size chunks carved out of big slabs, handed out as reference counted slices. A received chunk can be
+	parsed, split into sub-slices, handed to other threads and sent again without copying:
+		trecv_slice(fd, &pool, &s);
+		tbuf_ref(&body, &s, header_size, s.size - header_size);
+		tbuf_release(&s);
+		...on any thread: tsend_slice(out_fd, &body, 1); tbuf_release(&body);
+	The chunk returns to a freelist of the releasing thread once its last slice was released, so steady state
+	allocations take neither malloc nor a lock. A thread caches chunks of up to TBUF_THREAD_POOLS pools, using more
+	hands the chunks of the least recently added pool back to it. Chunks cached by a thread which exits are only
+	reclaimed by tbuf_pool_destroy.
+*/
+
+#define TBUF_THREAD_POOLS (8)
+#define TBUF_THREAD_CACHE (64)
+
+struct tbuf_pool;
+
+struct tbuf_chunk
+{
+	struct tbuf_pool *pool;
+	int refs;
+	struct tbuf_chunk *next;
+};
+
+struct tbuf_slice
+{
+	struct tbuf_chunk *chunk;
+	char *data;
+	int size;
+};
+
+struct tbuf_pool
+{
+	uint64_t id;
+	int chunk_size;
+	int stride;
+	int slab_chunks;
+	pthread_mutex_t lock;
+	struct tbuf_chunk *free;
+	void **slabs;
+	int slabs_count;
+	struct tbuf_pool *live_next;
+};
+
+/* Per-thread freelists, tagged with the id of their pool so lists of destroyed pools are never used */
+struct tbuf__cache
+{
+	uint64_t pool_id;
+	struct tbuf_chunk *free;
+	int count;
+};
+
+static uint64_t tbuf__next_id = 1;
+static __thread struct tbuf__cache tbuf__caches[TBUF_THREAD_POOLS];
+static __thread int tbuf__evict = 0;
+
+/* Pools not destroyed yet, so an evicted thread cache only hands chunks back to a pool which still exists */
+static pthread_mutex_t tbuf__live_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct tbuf_pool *tbuf__live = NULL;
+
+static void tbuf__cache_return(struct tbuf__cache *c)
+{
+	struct tbuf_pool *pool;
+	struct tbuf_chunk *last;
+	
+	if(c->free == NULL) return;
+	pthread_mutex_lock(&tbuf__live_lock);
+	for(pool = tbuf__live; pool != NULL && pool->id != c->pool_id; pool = pool->live_next);
+	if(pool != NULL)
+	{
+		for(last = c->free; last->next != NULL; last = last->next);
+		pthread_mutex_lock(&pool->lock);
+		last->next = pool->free;
+		pool->free = c->free;
+		pthread_mutex_unlock(&pool->lock);
+	}
+	pthread_mutex_unlock(&tbuf__live_lock);
+	c->free = NULL;
+	c->count = 0;
+}
+
+static struct tbuf__cache *tbuf__cache(struct tbuf_pool *pool)
+{
+	struct tbuf__cache *c;
+	int i;
+	
+	for(i = 0; i < TBUF_THREAD_POOLS; i++)
+	{
+		if(tbuf__caches[i].pool_id == pool->id) return &tbuf__caches[i];
+	}
+	// Take over a slot, handing its chunks (if any) back to their pool
+	for(i = 0; i < TBUF_THREAD_POOLS && tbuf__caches[i].pool_id != 0; i++);
+	if(i == TBUF_THREAD_POOLS)
+	{
+		i = tbuf__evict;
+		tbuf__evict = (tbuf__evict + 1) % TBUF_THREAD_POOLS;
+	}
+	c = &tbuf__caches[i];
+	tbuf__cache_return(c);
+	c->pool_id = pool->id;
+	c->free = NULL;
+	c->count = 0;
+	return c;
+}
+
+static char *tbuf__data(struct tbuf_chunk *chunk)
+{
+	return (char*)chunk + ((sizeof(struct tbuf_chunk) + 63) & ~(size_t)63);
+}
+
+
+#define TBUF_POOL_CREATE_ERRS (2)
+#define TBUF_POOL_CREATE_ERR_ARG (-1)
+#define TBUF_POOL_CREATE_ERR_ARG_STR "Invalid pool parameters"
+#define TBUF_POOL_CREATE_ERR_MEM (-2)
+#define TBUF_POOL_CREATE_ERR_MEM_STR "Unable to allocate memory"
+
+#define TBUF_POOL_CREATE_ERR__STR(err) ((err == TBUF_POOL_CREATE_ERR_ARG) ? TBUF_POOL_CREATE_ERR_ARG_STR : (err == TBUF_POOL_CREATE_ERR_MEM) ? TBUF_POOL_CREATE_ERR_MEM_STR : "")
+
+/**
+ * Sets up a buffer pool. Memory is allocated in slabs as needed.
+ * 
+ * struct tbuf_pool *pool: Pointer to the pool to initialize
+ * int chunk_size:         Size of every chunk in bytes
+ * int slab_chunks:        Number of chunks allocated at once
+ * 
+ * return:                 Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Invalid pool parameters =>   -1
+ *  Unable to allocate memory => -2
+ */
+int tbuf_pool_create(struct tbuf_pool *pool, int chunk_size, int slab_chunks)
+{
+	memset(pool, 0, sizeof *pool);
+	if(chunk_size < 1 || slab_chunks < 1)
+	{
+		return -1;
+	}
+	pool->id = __atomic_fetch_add(&tbuf__next_id, 1, __ATOMIC_RELAXED);
+	pool->chunk_size = chunk_size;
+	// Chunks start on cache lines, so two threads never share one
+	pool->stride = (int)(((sizeof(struct tbuf_chunk) + 63) & ~(size_t)63) + (((size_t)chunk_size + 63) & ~(size_t)63));
+	pool->slab_chunks = slab_chunks;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_mutex_lock(&tbuf__live_lock);
+	pool->live_next = tbuf__live;
+	tbuf__live = pool;
+	pthread_mutex_unlock(&tbuf__live_lock);
+	return 0;
+}
+
+
+#define TBUF_ALLOC_ERRS (1)
+#define TBUF_ALLOC_ERR_MEM (-1)
+#define TBUF_ALLOC_ERR_MEM_STR "Unable to allocate memory"
+
+#define TBUF_ALLOC_ERR__STR(err) ((err == TBUF_ALLOC_ERR_MEM) ? TBUF_ALLOC_ERR_MEM_STR : "")
+
+/**
+ * Takes a chunk from the pool. The slice covers the whole chunk and holds the only reference.
+ * 
+ * struct tbuf_pool *pool: Pool to allocate from
+ * struct tbuf_slice *s:   Slice which will be set to the new chunk
+ * 
+ * return:                 Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to allocate memory => -1
+ */
+int tbuf_alloc(struct tbuf_pool *pool, struct tbuf_slice *s)
+{
+	struct tbuf__cache *c = tbuf__cache(pool);
+	struct tbuf_chunk *chunk;
+	
+	if(c->free == NULL)
+	{
+		int i;
+		
+		pthread_mutex_lock(&pool->lock);
+		if(pool->free == NULL)
+		{
+			void *slab;
+			void **slabs;
+			
+			if((slabs = (void**)realloc(pool->slabs, (pool->slabs_count + 1) * sizeof *slabs)) == NULL)
+			{
+				pthread_mutex_unlock(&pool->lock);
+				return -1;
+			}
+			pool->slabs = slabs;
+			if(posix_memalign(&slab, 64, (size_t)pool->stride * pool->slab_chunks) != 0)
+			{
+				pthread_mutex_unlock(&pool->lock);
+				return -1;
+			}
+			pool->slabs[pool->slabs_count++] = slab;
+			for(i = pool->slab_chunks - 1; i >= 0; i--)
+			{
+				chunk = (struct tbuf_chunk*)((char*)slab + (size_t)i * pool->stride);
+				chunk->pool = pool;
+				chunk->next = pool->free;
+				pool->free = chunk;
+			}
+		}
+		// Refill half of the thread cache with one lock
+		for(i = 0; i < TBUF_THREAD_CACHE / 2 && pool->free != NULL; i++)
+		{
+			chunk = pool->free;
+			pool->free = chunk->next;
+			chunk->next = c->free;
+			c->free = chunk;
+			c->count++;
+		}
+		pthread_mutex_unlock(&pool->lock);
+	}
+	
+	chunk = c->free;
+	c->free = chunk->next;
+	c->count--;
+	chunk->refs = 1;
+	s->chunk = chunk;
+	s->data = tbuf__data(chunk);
+	s->size = pool->chunk_size;
+	return 0;
+}
+
+
+#define TBUF_REF_ERRS (1)
+#define TBUF_REF_ERR_RANGE (-1)
+#define TBUF_REF_ERR_RANGE_STR "Range lies outside the slice"
+
+#define TBUF_REF_ERR__STR(err) ((err == TBUF_REF_ERR_RANGE) ? TBUF_REF_ERR_RANGE_STR : "")
+
+/**
+ * Creates another reference to (a part of) a slice. Thread safe.
+ * 
+ * struct tbuf_slice *dst:       Slice which will be set to the new reference
+ * const struct tbuf_slice *src: Slice to reference
+ * int offset:                   Start of the new slice within [src]
+ * int size:                     Size of the new slice
+ * 
+ * return:                       Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Range lies outside the slice => -1
+ */
+int tbuf_ref(struct tbuf_slice *dst, const struct tbuf_slice *src, int offset, int size)
+{
+	if(offset < 0 || size < 0 || offset + size > src->size)
+	{
+		return -1;
+	}
+	__atomic_add_fetch(&src->chunk->refs, 1, __ATOMIC_RELAXED);
+	dst->chunk = src->chunk;
+	dst->data = src->data + offset;
+	dst->size = size;
+	return 0;
+}
+
+#define TBUF_RELEASE_ERRS (0)
+#define TBUF_RELEASE_ERR__STR(err) ""
+
+/**
+ * Drops a slice's reference. The last one returns the chunk to the calling thread's freelist. Thread safe.
+ * 
+ */
+void tbuf_release(struct tbuf_slice *s)
+{
+	struct tbuf_chunk *chunk = s->chunk;
+	struct tbuf_pool *pool;
+	struct tbuf__cache *c;
+	int i;
+	
+	s->chunk = NULL;
+	s->data = NULL;
+	s->size = 0;
+	if(chunk == NULL || __atomic_sub_fetch(&chunk->refs, 1, __ATOMIC_ACQ_REL) != 0) return;
+	
+	pool = chunk->pool;
+	c = tbuf__cache(pool);
+	chunk->next = c->free;
+	c->free = chunk;
+	if(++c->count <= TBUF_THREAD_CACHE) return;
+	
+	// Hand half back, so threads which only release (e.g. senders) don't hoard chunks
+	pthread_mutex_lock(&pool->lock);
+	for(i = 0; i < TBUF_THREAD_CACHE / 2; i++)
+	{
+		chunk = c->free;
+		c->free = chunk->next;
+		chunk->next = pool->free;
+		pool->free = chunk;
+		c->count--;
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+
+#define TRECV_SLICE_ERRS (2)
+#define TRECV_SLICE_ERR_NODATA (-1)
+#define TRECV_SLICE_ERR_NODATA_STR "Recieved no data or target disconnected"
+#define TRECV_SLICE_ERR_MEM (-2)
+#define TRECV_SLICE_ERR_MEM_STR "Unable to allocate memory"
+
+#define TRECV_SLICE_ERR__STR(err) ((err == TRECV_SLICE_ERR_NODATA) ? TRECV_SLICE_ERR_NODATA_STR : (err == TRECV_SLICE_ERR_MEM) ? TRECV_SLICE_ERR_MEM_STR : "")
+
+/**
+ * Receives data via TCP into a chunk taken from a pool.
+ * 
+ * int targetfd:           UNIX file descriptor of target (With TCP connection established)
+ * struct tbuf_pool *pool: Pool to take the chunk from
+ * struct tbuf_slice *s:   Slice which will be set to the received bytes (release it with tbuf_release)
+ * 
+ * return:                 Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Recieved no data or target disconnected => -1
+ *  Unable to allocate memory =>               -2
+ */
+int trecv_slice(int targetfd, struct tbuf_pool *pool, struct tbuf_slice *s)
+{
+	ssize_t received;
+	
+	if(tbuf_alloc(pool, s) < 0)
+	{
+		return -2;
+	}
+	do
+	{
+		received = recv(targetfd, s->data, s->size, 0);
+	}while(received == -1 && errno == EINTR);
+	if(received < 1)
+	{
+		tbuf_release(s);
+		return -1;
+	}
+	s->size = (int)received;
+	return 0;
+}
+
+
+#define TSEND_SLICE_ERRS (1)
+#define TSEND_SLICE_ERR_SEND (-1)
+#define TSEND_SLICE_ERR_SEND_STR "Unable to send data"
+
+#define TSEND_SLICE_ERR__STR(err) ((err == TSEND_SLICE_ERR_SEND) ? TSEND_SLICE_ERR_SEND_STR : "")
+
+/**
+ * Sends slices via TCP in order, with as few syscalls as possible. The slices are not released.
+ * 
+ * int targetfd:               UNIX file descriptor of target (With TCP connection established)
+ * const struct tbuf_slice *s: Array of slices to send
+ * int count:                  Number of entries in [s]
+ * 
+ * return:                     Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to send data => -1
+ */
+int tsend_slice(int targetfd, const struct tbuf_slice *s, int count)
+{
+	struct iovec iov[64];
+	int i, n;
+	
+	while(count > 0)
+	{
+		n = (count > 64) ? 64 : count;
+		for(i = 0; i < n; i++)
+		{
+			iov[i].iov_base = s[i].data;
+			iov[i].iov_len = s[i].size;
+		}
+		if(tsendv(targetfd, iov, n, NULL) < 0)
+		{
+			return -1;
+		}
+		s += n;
+		count -= n;
+	}
+	return 0;
+}
+
+#define TBUF_POOL_DESTROY_ERRS (0)
+#define TBUF_POOL_DESTROY_ERR__STR(err) ""
+
+/**
+ * Frees all memory of the pool. All slices taken from it become invalid.
+ * 
+ */
+void tbuf_pool_destroy(struct tbuf_pool *pool)
+{
+	struct tbuf__cache *c;
+	struct tbuf_pool **link;
+	int i;
+	
+	pthread_mutex_lock(&tbuf__live_lock);
+	for(link = &tbuf__live; *link != NULL && *link != pool; link = &(*link)->live_next);
+	if(*link != NULL) *link = pool->live_next;
+	pthread_mutex_unlock(&tbuf__live_lock);
+	// Drop this thread's list right away, other threads notice the changed id
+	for(i = 0; i < TBUF_THREAD_POOLS; i++)
+	{
+		c = &tbuf__caches[i];
+		if(c->pool_id == pool->id) memset(c, 0, sizeof *c);
+	}
+	for(i = 0; i < pool->slabs_count; i++)
+	{
+		free(pool->slabs[i]);
+	}
+	free(pool->slabs);
+	pool->slabs = NULL;
+	pool->slabs_count = 0;
+	pool->free = NULL;
+	pthread_mutex_destroy(&pool->lock);
+}
+
+/*
+Connection pool:
+	Hands out connected TCP file descriptors per (target, target_port) and takes them back after use,
+	so requests don't pay a handshake each. Idle connections are checked on checkout (closed by the peer or
+	unexpected pending data => replaced), closed after [idle_ms] and at most [max_per_host] connections
+	(idle and checked out) exist per host. All functions are thread safe.
+		fd = tpool_get(&pool, "10.0.3.17", "80");
+		ret = tsend_recv(fd, bytes, &bytes_size);
+		tpool_put(&pool, "10.0.3.17", "80", fd, ret == 0);
+*/
+
+#define TPOOL_BUCKETS (64)
+
+struct tpool_host
+{
+	struct tpool_host *next;
+	char *target;
+	char *target_port;
+	int open;
+	int idle_count;
+	int *idle_fds;
+	int64_t *idle_since_ms;
+};
+
+struct tpool
+{
+	pthread_mutex_t lock;
+	struct tpool_host *buckets[TPOOL_BUCKETS];
+	int max_per_host;
+	int idle_ms;
+	int connect_timeout_ms;
+};
+
+
+#define TPOOL_CREATE_ERRS (2)
+#define TPOOL_CREATE_ERR_ARG (-1)
+#define TPOOL_CREATE_ERR_ARG_STR "Invalid pool parameters"
+#define TPOOL_CREATE_ERR_LOCK (-2)
+#define TPOOL_CREATE_ERR_LOCK_STR "Unable to set up lock"
+
+#define TPOOL_CREATE_ERR__STR(err) ((err == TPOOL_CREATE_ERR_ARG) ? TPOOL_CREATE_ERR_ARG_STR : (err == TPOOL_CREATE_ERR_LOCK) ? TPOOL_CREATE_ERR_LOCK_STR : "")
+
+/**
+ * Sets up a connection pool.
+ * 
+ * struct tpool *pool:     Pointer to the pool to initialize
+ * int max_per_host:       Maximum number of connections (idle and checked out) per host
+ * int idle_ms:            Idle connections older than this are closed (in milliseconds)
+ * int connect_timeout_ms: Timeout for establishing new connections (in milliseconds, -1 for none)
+ * 
+ * return:                 Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Invalid pool parameters => -1
+ *  Unable to set up lock =>   -2
+ */
+int tpool_create(struct tpool *pool, int max_per_host, int idle_ms, int connect_timeout_ms)
+{
+	memset(pool, 0, sizeof *pool);
+	if(max_per_host < 1 || idle_ms < 0)
+	{
+		return -1;
+	}
+	if(pthread_mutex_init(&pool->lock, NULL) != 0)
+	{
+		return -2;
+	}
+	pool->max_per_host = max_per_host;
+	pool->idle_ms = idle_ms;
+	pool->connect_timeout_ms = connect_timeout_ms;
+	return 0;
+}
+
+/* Finds (or with [create] set, adds) the entry of a host. Lock held. */
+static struct tpool_host *tpool__host(struct tpool *pool, const char* target, const char* target_port, int create)
+{
+	unsigned int bucket = dns__hash(target, target_port, SOCK_STREAM, 0) % TPOOL_BUCKETS;
+	struct tpool_host *h;
+	
+	for(h = pool->buckets[bucket]; h != NULL; h = h->next)
+	{
+		if(strcmp(h->target, target) == 0 && strcmp(h->target_port, target_port) == 0) return h;
+	}
+	if(!create)
+	{
+		return NULL;
+	}
+	if((h = (struct tpool_host*)calloc(1, sizeof *h)) == NULL)
+	{
+		return NULL;
+	}
+	h->target = strdup(target);
+	h->target_port = strdup(target_port);
+	h->idle_fds = (int*)malloc(pool->max_per_host * sizeof *h->idle_fds);
+	h->idle_since_ms = (int64_t*)malloc(pool->max_per_host * sizeof *h->idle_since_ms);
+	if(h->target == NULL || h->target_port == NULL || h->idle_fds == NULL || h->idle_since_ms == NULL)
+	{
+		free(h->target);
+		free(h->target_port);
+		free(h->idle_fds);
+		free(h->idle_since_ms);
+		free(h);
+		return NULL;
+	}
+	h->next = pool->buckets[bucket];
+	pool->buckets[bucket] = h;
+	return h;
+}
+
+/* Closes idle connections of [h] older than the pool's idle time (oldest are at the front). Lock held. */
+static int tpool__evict_host(struct tpool *pool, struct tpool_host *h, int64_t now)
+{
+	int expired = 0;
+	
+	while(expired < h->idle_count && now - h->idle_since_ms[expired] >= pool->idle_ms)
+	{
+		close(h->idle_fds[expired]);
+		expired++;
+	}
+	if(expired > 0)
+	{
+		memmove(h->idle_fds, h->idle_fds + expired, (h->idle_count - expired) * sizeof *h->idle_fds);
+		memmove(h->idle_since_ms, h->idle_since_ms + expired, (h->idle_count - expired) * sizeof *h->idle_since_ms);
+		h->idle_count -= expired;
+		h->open -= expired;
+	}
+	return expired;
+}
+
+/* An idle connection is usable if the peer did not close it and sent nothing unrequested */
+static int tpool__healthy(int fd)
+{
+	char probe;
+	ssize_t ret;
+	
+	do
+	{
+		ret = recv(fd, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+	}while(ret == -1 && errno == EINTR);
+	return ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+
+#define TPOOL_GET_ERRS (5)
+#define TPOOL_GET_ERR_ADDR (-1)
+#define TPOOL_GET_ERR_ADDR_STR "Unable to resolve address"
+#define TPOOL_GET_ERR_CONN (-2)
+#define TPOOL_GET_ERR_CONN_STR "Unable to connect to server"
+#define TPOOL_GET_ERR_TIMEOUT (-3)
+#define TPOOL_GET_ERR_TIMEOUT_STR "Connecting to server timed out"
+#define TPOOL_GET_ERR_LIMIT (-4)
+#define TPOOL_GET_ERR_LIMIT_STR "Connection limit for host reached"
+#define TPOOL_GET_ERR_MEM (-5)
+#define TPOOL_GET_ERR_MEM_STR "Unable to allocate memory"
+
+#define TPOOL_GET_ERR__STR(err) ((err == TPOOL_GET_ERR_ADDR) ? TPOOL_GET_ERR_ADDR_STR : (err == TPOOL_GET_ERR_CONN) ? TPOOL_GET_ERR_CONN_STR : (err == TPOOL_GET_ERR_TIMEOUT) ? TPOOL_GET_ERR_TIMEOUT_STR : (err == TPOOL_GET_ERR_LIMIT) ? TPOOL_GET_ERR_LIMIT_STR : (err == TPOOL_GET_ERR_MEM) ? TPOOL_GET_ERR_MEM_STR : "")
+
+/**
+ * Checks out a connection to target host. Reuses the most recently returned healthy idle connection
+ * and connects a new one if there is none.
+ * 
+ * struct tpool *pool:      Pool to take the connection from
+ * const char* target:      IP or web address of host to connect to (e.g. "192.168.0.1", "www.example.com")
+ * const char* target_port: Port to connect to at target (e.g. "80", "1729")
+ * 
+ * return:                  Returns UNIX file descriptor (hand it back with tpool_put). Returns error code upon failure (error codes below)
+ * 
+ * {error codes}:
+ *  Unable to resolve address =>         -1
+ *  Unable to connect to server =>       -2
+ *  Connecting to server timed out =>    -3
+ *  Connection limit for host reached => -4
+ *  Unable to allocate memory =>         -5
+ */
+int tpool_get(struct tpool *pool, const char* target, const char* target_port)
+{
+	struct tpool_host *h;
+	int retfd;
+	
+	pthread_mutex_lock(&pool->lock);
+	if((h = tpool__host(pool, target, target_port, 1)) == NULL)
+	{
+		pthread_mutex_unlock(&pool->lock);
+		return -5;
+	}
+	tpool__evict_host(pool, h, netlib__now_ms());
+	while(h->idle_count > 0)
+	{
+		retfd = h->idle_fds[--h->idle_count];
+		if(tpool__healthy(retfd))
+		{
+			pthread_mutex_unlock(&pool->lock);
+			return retfd;
+		}
+		close(retfd);
+		h->open--;
+	}
+	if(h->open >= pool->max_per_host)
+	{
+		pthread_mutex_unlock(&pool->lock);
+		return -4;
+	}
+	h->open++;
+	pthread_mutex_unlock(&pool->lock);
+	
+	// Connect without holding the lock, the slot is reserved already
+	if((retfd = tconnect_timeout(target, target_port, pool->connect_timeout_ms)) < 0)
+	{
+		pthread_mutex_lock(&pool->lock);
+		h->open--;
+		pthread_mutex_unlock(&pool->lock);
+		return (retfd == TCONNECT_TIMEOUT_ERR_ADDR) ? -1 : (retfd == TCONNECT_TIMEOUT_ERR_TIMEOUT) ? -3 : -2;
+	}
+	return retfd;
+}
+
+
+#define TPOOL_PUT_ERRS (1)
+#define TPOOL_PUT_ERR_HOST (-1)
+#define TPOOL_PUT_ERR_HOST_STR "Connection does not belong to pool"
+
+#define TPOOL_PUT_ERR__STR(err) ((err == TPOOL_PUT_ERR_HOST) ? TPOOL_PUT_ERR_HOST_STR : "")
+
+/**
+ * Returns a connection checked out with tpool_get. Broken connections are closed instead of kept.
+ * 
+ * struct tpool *pool:      Pool the connection was taken from
+ * const char* target:      Target the connection was checked out for
+ * const char* target_port: Port the connection was checked out for
+ * int targetfd:            UNIX file descriptor returned by tpool_get
+ * int reusable:            1 if the connection is in a clean state (e.g. the last request succeeded), 0 to close it
+ * 
+ * return:                  Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Connection does not belong to pool => -1
+ */
+int tpool_put(struct tpool *pool, const char* target, const char* target_port, int targetfd, int reusable)
+{
+	struct tpool_host *h;
+	int64_t now = netlib__now_ms();
+	
+	pthread_mutex_lock(&pool->lock);
+	if((h = tpool__host(pool, target, target_port, 0)) == NULL || h->idle_count >= h->open)
+	{
+		pthread_mutex_unlock(&pool->lock);
+		close(targetfd);
+		return -1;
+	}
+	tpool__evict_host(pool, h, now);
+	if(!reusable)
+	{
+		close(targetfd);
+		h->open--;
+	}
+	else
+	{
+		h->idle_fds[h->idle_count] = targetfd;
+		h->idle_since_ms[h->idle_count] = now;
+		h->idle_count++;
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return 0;
+}
+
+
+#define TPOOL_PREWARM_ERRS (5)
+#define TPOOL_PREWARM_ERR_ADDR (-1)
+#define TPOOL_PREWARM_ERR_ADDR_STR "Unable to resolve address"
+#define TPOOL_PREWARM_ERR_CONN (-2)
+#define TPOOL_PREWARM_ERR_CONN_STR "Unable to connect to server"
+#define TPOOL_PREWARM_ERR_TIMEOUT (-3)
+#define TPOOL_PREWARM_ERR_TIMEOUT_STR "Connecting to server timed out"
+#define TPOOL_PREWARM_ERR_LIMIT (-4)
+#define TPOOL_PREWARM_ERR_LIMIT_STR "Connection limit for host reached"
+#define TPOOL_PREWARM_ERR_MEM (-5)
+#define TPOOL_PREWARM_ERR_MEM_STR "Unable to allocate memory"
+
+#define TPOOL_PREWARM_ERR__STR(err) ((err == TPOOL_PREWARM_ERR_ADDR) ? TPOOL_PREWARM_ERR_ADDR_STR : (err == TPOOL_PREWARM_ERR_CONN) ? TPOOL_PREWARM_ERR_CONN_STR : (err == TPOOL_PREWARM_ERR_TIMEOUT) ? TPOOL_PREWARM_ERR_TIMEOUT_STR : (err == TPOOL_PREWARM_ERR_LIMIT) ? TPOOL_PREWARM_ERR_LIMIT_STR : (err == TPOOL_PREWARM_ERR_MEM) ? TPOOL_PREWARM_ERR_MEM_STR : "")
+
+/**
+ * Opens connections to target host ahead of time (e.g. at startup), until [count] connections are idle.
+ * 
+ * struct tpool *pool:      Pool to fill
+ * const char* target:      IP or web address of host to connect to (e.g. "192.168.0.1", "www.example.com")
+ * const char* target_port: Port to connect to at target (e.g. "80", "1729")
+ * int count:               Number of idle connections wanted (capped by the pool's max_per_host)
+ * 
+ * return:                  Returns number of connections opened. Returns error code if not a single one could be opened (error codes below)
+ * 
+ * {error codes}:
+ *  Unable to resolve address =>         -1
+ *  Unable to connect to server =>       -2
+ *  Connecting to server timed out =>    -3
+ *  Connection limit for host reached => -4
+ *  Unable to allocate memory =>         -5
+ */
+int tpool_prewarm(struct tpool *pool, const char* target, const char* target_port, int count)
+{
+	struct tpool_host *h;
+	int opened = 0, idle, fd;
+	
+	for(;;)
+	{
+		pthread_mutex_lock(&pool->lock);
+		h = tpool__host(pool, target, target_port, 1);
+		idle = h ? h->idle_count : 0;
+		pthread_mutex_unlock(&pool->lock);
+		if(h == NULL)
+		{
+			return opened ? opened : -5;
+		}
+		if(idle >= count) break;
+		
+		// tpool_get only reuses idle connections if there are any, so bypass it for opening new ones
+		pthread_mutex_lock(&pool->lock);
+		if(h->open >= pool->max_per_host)
+		{
+			pthread_mutex_unlock(&pool->lock);
+			return opened ? opened : -4;
+		}
+		h->open++;
+		pthread_mutex_unlock(&pool->lock);
+		if((fd = tconnect_timeout(target, target_port, pool->connect_timeout_ms)) < 0)
+		{
+			pthread_mutex_lock(&pool->lock);
+			h->open--;
+			pthread_mutex_unlock(&pool->lock);
+			if(opened) return opened;
+			return (fd == TCONNECT_TIMEOUT_ERR_ADDR) ? -1 : (fd == TCONNECT_TIMEOUT_ERR_TIMEOUT) ? -3 : -2;
+		}
+		tpool_put(pool, target, target_port, fd, 1);
+		opened++;
+	}
+	return opened;
+}
+
+#define TPOOL_EVICT_ERRS (0)
+#define TPOOL_EVICT_ERR__STR(err) ""
+
+/**
+ * Closes all idle connections which exceeded the pool's idle time. Also happens lazily on every tpool_get / tpool_put of a host.
+ * 
+ * return: Returns number of connections closed
+ */
+int tpool_evict(struct tpool *pool)
+{
+	struct tpool_host *h;
+	int64_t now = netlib__now_ms();
+	int i, closed = 0;
+	
+	pthread_mutex_lock(&pool->lock);
+	for(i = 0; i < TPOOL_BUCKETS; i++)
+	{
+		for(h = pool->buckets[i]; h != NULL; h = h->next)
+		{
+			closed += tpool__evict_host(pool, h, now);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return closed;
+}
+
+#define TPOOL_DESTROY_ERRS (0)
+#define TPOOL_DESTROY_ERR__STR(err) ""
+
+/**
+ * Closes all idle connections and frees the pool. Connections still checked out are not affected.
+ * 
+ */
+void tpool_destroy(struct tpool *pool)
+{
+	struct tpool_host *h, *next;
+	int i, j;
+	
+	for(i = 0; i < TPOOL_BUCKETS; i++)
+	{
+		for(h = pool->buckets[i]; h != NULL; h = next)
+		{
+			next = h->next;
+			for(j = 0; j < h->idle_count; j++) close(h->idle_fds[j]);
+			free(h->target);
+			free(h->target_port);
+			free(h->idle_fds);
+			free(h->idle_since_ms);
+			free(h);
+		}
+		pool->buckets[i] = NULL;
+	}
+	pthread_mutex_destroy(&pool->lock);
+}
+
+#define HOST_REUSEPORT (1)
+#define HOST_DUALSTACK (2)
+
+#define TCREATE_HOST_EX_ERRS (4)
+#define TCREATE_HOST_EX_ERR_ADDR (-1)
+#define TCREATE_HOST_EX_ERR_ADDR_STR "Unable to resolve address"
+#define TCREATE_HOST_EX_ERR_FD (-2)
+#define TCREATE_HOST_EX_ERR_FD_STR "Unable to set up files descriptor"
+#define TCREATE_HOST_EX_ERR_PORT (-3)
+#define TCREATE_HOST_EX_ERR_PORT_STR "Unable to bind to port"
+#define TCREATE_HOST_EX_ERR_FPORT (-4)
+#define TCREATE_HOST_EX_ERR_FPORT_STR "Unable to force bind to port"
+
+#define TCREATE_HOST_EX_ERR__STR(err) ((err == TCREATE_HOST_EX_ERR_ADDR) ? TCREATE_HOST_EX_ERR_ADDR_STR : (err == TCREATE_HOST_EX_ERR_FD) ? TCREATE_HOST_EX_ERR_FD_STR : (err == TCREATE_HOST_EX_ERR_PORT) ? TCREATE_HOST_EX_ERR_PORT_STR : (err == TCREATE_HOST_EX_ERR_FPORT) ? TCREATE_HOST_EX_ERR_FPORT_STR : "")
+
+/**
+ * Creates a TCP host on port [PORT] like tcreate_host, with additional options.
+ * 
+ * const char* PORT: The port on which to listen for incoming connections (as a C string [a.k.a. char pointer])
+ * int flags:        HOST_* flags (0 behaves like tcreate_host):
+ *                    HOST_REUSEPORT: Allow multiple sockets to bind the same port (SO_REUSEPORT), the kernel spreads incoming traffic across them
+ *                    HOST_DUALSTACK: Bind one IPv6 socket with IPV6_V6ONLY disabled, which serves IPv4 and IPv6 clients alike
+ * 
+ * return:           Returns UNIX file descriptor on which one can listen for & accept incomming connections. Returns error code upon failure (error codes below)
+ * 
+ * {error codes}:
+ *  Unable to resolve address =>                                     -1
+ *  Unable to set up UNIX files descriptor =>                        -2
+ *  Unable to bind to port =>                                        -3
+ *  Unable to force bind to port (Enable reuse of address / port) => -4
+ */
+int tcreate_host_ex(const char* PORT, int flags)
+{
+	int retfd;
+	struct addrinfo *servinfo, *ai;
+	
+	if(dns_lookup(NULL, PORT, SOCK_STREAM, AI_PASSIVE, &servinfo) != 0)
+	{
+		return -1;
+	}
+	
+	ai = servinfo;
+	if(flags & HOST_DUALSTACK)
+	{
+		// A single IPv6 wildcard socket accepting IPv4 clients too (as IPv4 mapped addresses)
+		for(ai = servinfo; ai != NULL && ai->ai_family != AF_INET6; ai = ai->ai_next);
+		if(ai == NULL) ai = servinfo;
+	}
+	
+	if((retfd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) == -1)
+	{
+		dns_release(servinfo);
+		return -2;
+	}
+	
+	int yes = 1;
+	if (setsockopt(retfd,SOL_SOCKET,SO_REUSEADDR,&yes,sizeof(int)) == -1) {
+		close(retfd);
+		dns_release(servinfo);
+		return -4;
+	}
+	
+	if((flags & HOST_REUSEPORT) && setsockopt(retfd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(int)) == -1)
+	{
+		close(retfd);
+		dns_release(servinfo);
+		return -4;
+	}
+	
+	int no = 0;
+	if(ai->ai_family == AF_INET6 && (flags & HOST_DUALSTACK) && setsockopt(retfd, IPPROTO_IPV6, IPV6_V6ONLY, &no, sizeof(int)) == -1)
+	{
+		close(retfd);
+		dns_release(servinfo);
+		return -2;
+	}
+	
+	if(bind(retfd, ai->ai_addr, ai->ai_addrlen) == -1)
+	{
+		close(retfd);
+		dns_release(servinfo);
+		return -3;
+	}
+	
+	dns_release(servinfo);
+	
+	return retfd;
+}
+
+
+#define TCREATE_HOST_ERRS (4)
+#define TCREATE_HOST_ERR_ADDR (-1)
+#define TCREATE_HOST_ERR_ADDR_STR "Unable to resolve address"
+#define TCREATE_HOST_ERR_FD (-2)
+#define TCREATE_HOST_ERR_FD_STR "Unable to set up files descriptor"
+#define TCREATE_HOST_ERR_PORT (-3)
+#define TCREATE_HOST_ERR_PORT_STR "Unable to bind to port"
+#define TCREATE_HOST_ERR_FPORT (-4)
+#define TCREATE_HOST_ERR_FPORT_STR "Unable to force bind to port"
+
+#define TCREATE_HOST_ERR__STR(err) ((err == TCREATE_HOST_ERR_ADDR) ? TCREATE_HOST_ERR_ADDR : (err == TCREATE_HOST_ERR_FD) ? TCREATE_HOST_ERR_FD_STR :(err == TCREATE_HOST_ERR_PORT) ? TCREATE_HOST_ERR_PORT_STR : (err == TCREATE_HOST_ERR_FPORT) ? TCREATE_HOST_ERR_FPORT_STR : "")
+
+/**
+ * Creates a TCP host on port [PORT] and returns UNIX file descriptor.
+ * 
+ * const char* PORT: The port on which to listen for incoming connections (as a C string [a.k.a. char pointer])
+ * 
+ * return:           Returns UNIX file descriptor on which one can listen for & accept incomming connections. Returns error code upon failure (error codes below)
+ * 
+ * {error codes}:
+ *  Unable to resolve address =>                           -1
+ *  Unable to set up UNIX files descriptor =>              -2
+ *  Unable to bind to port =>                              -3
+ *  Unable to force bind to port (Enable reuse of port) => -4
+ */
+int tcreate_host(const char* PORT)
+{
+	return tcreate_host_ex(PORT, 0);
+}
+
+
+#define TLISTEN_ACCEPT_ERRS (2)
+#define TLISTEN_ACCEPT_ERR_LISTEN (-1)
+#define TLISTEN_ACCEPT_ERR_LISTEN_STR "Unable to listen for incoming connection"
+#define TLISTEN_ACCEPT_ERR_ACCEPT (-2)
+#define TLISTEN_ACCEPT_ERR_ACCEPT_STR "Unable to accept incoming connection"
+
+#define TLISTEN_ACCEPT_ERR__STR(err) ((err == TLISTEN_ACCEPT_ERR_LISTEN) ? TLISTEN_ACCEPT_ERR_LISTEN_STR : (err == TLISTEN_ACCEPT_ERR_ACCEPT) ? TLISTEN_ACCEPT_ERR_ACCEPT_STR : "")
+
+/**
+ * Listens on given UNIX file descriptor form incomming connections accepts the first it gets. Returns file descriptor.
+ * This function will block until either an error occured or a connection was successfully established!
+ * 
+ * int sockfd:        UNIX file descriptor on which the Kernel is listening for incoming connections
+ * const int BACKLOG: The amount of connections the queue will hold. Should be equal to or less than real backlog, which is defined by the kernel (e.g. 128 for linux kernel version 2.x)
+ * 
+ * return:           Returns UNIX file descriptor over which one can communicate with connecting node. Returns error code upon failure (error codes below)
+ * 
+ * {error codes}:
+ *  Unable to listen for incoming connection =>  -1
+ *  Unable to accept incoming connection =>      -2
+ */
+int tlisten_accept(int sockfd, const int BACKLOG)
+{
+	int retfd;
+	struct sockaddr_storage conn_addr;
+	socklen_t conn_addr_size = sizeof conn_addr;
+	
+	if(listen(sockfd, BACKLOG) == -1)
+	{
+		return -1;
+	}
+	
+	if((retfd = accept(sockfd, (struct sockaddr*)&conn_addr, &conn_addr_size)) == -1)
+	{
+		return -2;
+	}
+	
+	return retfd;
+}
+
+
+/**
+ * Listens on given UNIX file descriptor form incomming connections accepts the first it gets. Returns file descriptor.
+ * This function will block until either an error occured or a connection was successfully established!
+ * 
+ * int sockfd:                    UNIX file descriptor on which the Kernel is listening for incoming connections
+ * const int BACKLOG:             The amount of connections the queue will hold. Should be equal to or less than real backlog, which is defined by the kernel (e.g. 128 for linux kernel version 2.x)
+ * struct sockaddr_storage &addr: Reference to struct in which information about connecting node will be saved
+ * socklen_t &addr_size:          Size of [addr]
+ * 
+ * return:                        Returns UNIX file descriptor over which one can communicate with connecting node. Returns error code upon failure (error codes below)
+ * 
+ * {error codes}:
+ *  Unable to listen for incoming connection =>  -1
+ *  Unable to accept incoming connection =>      -2
+ */
+int tlisten_accept_a(int sockfd, const int BACKLOG, struct sockaddr_storage *addr, socklen_t *addr_size)
+{
+	int retfd;
+	
+	if(listen(sockfd, BACKLOG) == -1)
+	{
+		return -1;
+	}
+	
+	if((retfd = accept(sockfd, (struct sockaddr*)addr, addr_size)) == -1)
+	{
+		return -2;
+	}
+	
+	return retfd;
+}
+
+/*
+Listener:
+	Calls listen() once and then drains the accept queue in batches, so a burst of connections is accepted in one wakeup:
+		sockfd = tcreate_host("1729");
+		tlistener_create(&l, sockfd, 1024);
+		reactor_add(&r, l.fd, EPOLLIN, on_accept, &l);  // on_accept calls tlistener_accept_batch until it returns 0
+*/
+
+struct tlistener
+{
+	int fd;
+	int backlog;
+};
+
+
+#define TLISTENER_CREATE_ERRS (2)
+#define TLISTENER_CREATE_ERR_LISTEN (-1)
+#define TLISTENER_CREATE_ERR_LISTEN_STR "Unable to listen for incoming connection"
+#define TLISTENER_CREATE_ERR_FD (-2)
+#define TLISTENER_CREATE_ERR_FD_STR "Unable to set up files descriptor"
+
+#define TLISTENER_CREATE_ERR__STR(err) ((err == TLISTENER_CREATE_ERR_LISTEN) ? TLISTENER_CREATE_ERR_LISTEN_STR : (err == TLISTENER_CREATE_ERR_FD) ? TLISTENER_CREATE_ERR_FD_STR : "")
+
+/**
+ * Turns a host socket into a persistent, non-blocking listener.
+ * 
+ * struct tlistener *l: Pointer to the listener to initialize
+ * int sockfd:          UNIX file descriptor returned by tcreate_host (owned by the listener afterwards)
+ * int backlog:         The amount of connections the accept queue will hold (capped by the kernel, e.g. net.core.somaxconn)
+ * 
+ * return:              Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to listen for incoming connection => -1
+ *  Unable to set up files descriptor =>        -2
+ */
+int tlistener_create(struct tlistener *l, int sockfd, int backlog)
+{
+	l->fd = sockfd;
+	l->backlog = backlog;
+	if(listen(sockfd, backlog) == -1)
+	{
+		return -1;
+	}
+	if(set_nonblock(sockfd, 1) < 0)
+	{
+		return -2;
+	}
+	return 0;
+}
+
+
+#define TLISTENER_ACCEPT_BATCH_ERRS (1)
+#define TLISTENER_ACCEPT_BATCH_ERR_ACCEPT (-1)
+#define TLISTENER_ACCEPT_BATCH_ERR_ACCEPT_STR "Unable to accept incoming connection"
+
+#define TLISTENER_ACCEPT_BATCH_ERR__STR(err) ((err == TLISTENER_ACCEPT_BATCH_ERR_ACCEPT) ? TLISTENER_ACCEPT_BATCH_ERR_ACCEPT_STR : "")
+
+/**
+ * Accepts pending connections until the accept queue is empty or [max_fds] connections were accepted.
+ * Accepted file descriptors are non-blocking and close-on-exec. Never blocks.
+ * 
+ * struct tlistener *l:            Listener to accept on
+ * int *fds:                       Array in which the accepted file descriptors will be saved
+ * struct sockaddr_storage *addrs: Array in which the addresses of the connecting nodes will be saved (may be NULL)
+ * int max_fds:                    Number of entries in [fds] (and [addrs])
+ * 
+ * return:                         Returns number of accepted connections (0 if none were pending) and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to accept incoming connection => -1
+ */
+int tlistener_accept_batch(struct tlistener *l, int *fds, struct sockaddr_storage *addrs, int max_fds)
+{
+	int accepted = 0;
+	
+	while(accepted < max_fds)
+	{
+		socklen_t addr_size = sizeof(struct sockaddr_storage);
+		int fd = accept4(l->fd, addrs ? (struct sockaddr*)&addrs[accepted] : NULL, addrs ? &addr_size : NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		
+		if(fd == -1)
+		{
+			// Connections aborted while queued are simply skipped
+			if(errno == EINTR || errno == ECONNABORTED) continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+			return accepted ? accepted : -1;
+		}
+		fds[accepted++] = fd;
+	}
+	return accepted;
+}
+
+#define TLISTENER_CLOSE_ERRS (0)
+#define TLISTENER_CLOSE_ERR__STR(err) ""
+
+/**
+ * Closes the listening socket.
+ * 
+ */
+void tlistener_close(struct tlistener *l)
+{
+	close(l->fd);
+	l->fd = -1;
+}
+
+
+#define USOCK_ERRS (2)
+#define USOCK_ERR_ADDR (-1)
+#define USOCK_ERR_ADDR_STR "Unable to resolve address"
+#define USOCK_ERR_SOCK (-2)
+#define USOCK_ERR_SOCK_STR "Unable to set up socket"
+
+#define USOCK_ERR__STR(err) ((err == USOCK_ERR_ADDR) ? USOCK_ERR_ADDR_STR : (err == USOCK_ERR_SOCK) ? USOCK_ERR_SOCK_STR : "")
+
+/**
+ * Resolve target address and return UNIX file descriptor. Bypasses the DNS cache, use usock_cached to resolve through it.
+ * Literals (e.g. "10.0.3.17", "::1" with a numeric port) skip the resolver configuration but are still allocated,
+ * usock_cached only allocates them on the first call.
+ * 
+ * const char* target:          IP or web address of host to send to (e.g. "192.168.0.1", "www.example.com")
+ * const char* target_port:     Port to send to at target (e.g. "80", "1729")
+ * struct addrinfo *targetinfo: Pointer to addrinfo structure in which infos about the target will be saved (required for usend).
+ *                              Free it with freeaddrinfo, it is set to NULL upon failure.
+ * 
+ * return:                      Returns UNIX file descriptor to socket over which one can send UDP packages. Returns error code upon failure (error codes below)
+ * 
+ * {error codes}:
+ *  Unable to resolve address => -1
+ *  Unable to set up socket =>   -2
+ */
+int usock(const char* target, const char* target_port, struct addrinfo **targetinfo)
+{
+	struct addrinfo hints;
+	struct sockaddr_storage addr;
+	socklen_t addr_size;
+	int retfd;
+	
+	memset(&hints, 0, sizeof hints);
+	
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	if(dns_numeric(target, target_port, &addr, &addr_size) == 0)
+	{
+		// Literal: getaddrinfo only converts it, without consulting nsswitch or the hosts file
+		hints.ai_family = addr.ss_family;
+		hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+	}
+	
+	if(getaddrinfo(target, target_port, &hints, targetinfo) != 0)
+	{
+		*targetinfo = NULL;
+		return -1;
+	}
+	
+	if((retfd = socket((*targetinfo)->ai_family, (*targetinfo)->ai_socktype, (*targetinfo)->ai_protocol)) == -1)
+	{
+		freeaddrinfo(*targetinfo);
+		*targetinfo = NULL;
+		return -2;
+	}
+	return retfd;
+}
+
+
+#define USOCK_CACHED_ERRS (2)
+#define USOCK_CACHED_ERR_ADDR (-1)
+#define USOCK_CACHED_ERR_ADDR_STR "Unable to resolve address"
+#define USOCK_CACHED_ERR_SOCK (-2)
+#define USOCK_CACHED_ERR_SOCK_STR "Unable to set up socket"
+
+#define USOCK_CACHED_ERR__STR(err) ((err == USOCK_CACHED_ERR_ADDR) ? USOCK_CACHED_ERR_ADDR_STR : (err == USOCK_CACHED_ERR_SOCK) ? USOCK_CACHED_ERR_SOCK_STR : "")
+
+/**
+ * Like usock, but resolves through the DNS cache. Literals (e.g. "10.0.3.17" with a numeric port) never reach getaddrinfo
+ * and, once cached, later calls for the same target allocate nothing.
+ * 
+ * const char* target:          IP or web address of host to send to (e.g. "192.168.0.1", "www.example.com")
+ * const char* target_port:     Port to send to at target (e.g. "80", "1729")
+ * struct addrinfo *targetinfo: Pointer to addrinfo structure in which infos about the target will be saved (required for usend).
+ *                              It is shared with the DNS cache, release it with dns_release (not freeaddrinfo)!
+ * 
+ * return:                      Returns UNIX file descriptor to socket over which one can send UDP packages. Returns error code upon failure (error codes below)
+ * 
+ * {error codes}:
+ *  Unable to resolve address => -1
+ *  Unable to set up socket =>   -2
+ */
+int usock_cached(const char* target, const char* target_port, struct addrinfo **targetinfo)
+{
+	int retfd;
+	
+	if(dns_lookup(target, target_port, SOCK_DGRAM, 0, targetinfo) != 0)
+	{
+		return -1;
+	}
+	
+	if((retfd = socket((*targetinfo)->ai_family, (*targetinfo)->ai_socktype, (*targetinfo)->ai_protocol)) == -1)
+	{
+		dns_release(*targetinfo);
+		*targetinfo = NULL;
+		return -2;
+	}
+	return retfd;
+}
+
+
+#define USEND_ERRS (1)
+#define USEND_ERR_SEND (-1)
+#define USEND_ERR_SEND_STR "Unable to send data"
+
+#define USEND_ERR__STR(err) ((err == USEND_ERR_SEND) ? USEND_ERR_SEND_STR : "")
+
+/**
+ * Send data via UDP.
+ * 
+ * int sockfd:                  Socket over which packets will be send
+ * struct addrinfo *targetinfo: Pointer to addrinfo structure in which infos about the target will be saved (required for usend)
+ * const char* data             Pointer to data which will be send
+ * const int DATA_SIZE          Size of [data] memory block
+ * 
+ * return:                      Returns bytes sent (might not be equal to DATA_SIZE)
+ *
+ * {error codes}:
+ *  Unable to send data =>       -1
+ */
+int usend(int sockfd, struct addrinfo *targetinfo, const char* data, const int DATA_SIZE)
+{
+	return sendto(sockfd, data, DATA_SIZE, 0, targetinfo->ai_addr, targetinfo->ai_addrlen);
+}
+
+
+
+#define URECVFROM_ERRS (2)
+#define URECVFROM_ERR_NODATA (-1)
+#define URECVFROM_ERR_NODATA_STR "Received no data"
+#define URECVFROM_ERR_TRUNC (-2)
+#define URECVFROM_ERR_TRUNC_STR "Datagram was larger than buffer"
+
+#define URECVFROM_ERR__STR(err) ((err == URECVFROM_ERR_NODATA) ? URECVFROM_ERR_NODATA_STR : (err == URECVFROM_ERR_TRUNC) ? URECVFROM_ERR_TRUNC_STR : "")
+
+/**
+ * Receives a single datagram via UDP into a caller owned buffer and saves its source address.
+ * Oversized datagrams are detected with the same read: the buffer holds the start of the datagram and
+ * [bytes_size] is set to the full size of the datagram.
+ * 
+ * int sockfd:                    Socket on which packets are received (e.g. from ucreate_host)
+ * char* bytes:                   Pointer to the bytes where the received datagram will be written
+ * int *bytes_size:               Number of bytes allocated at [bytes]. Will be set to size of the datagram!
+ * struct sockaddr_storage *addr: Struct in which the address of the sending node will be saved (may be NULL)
+ * socklen_t *addr_size:          Will be set to the size of [addr] (may be NULL if [addr] is NULL)
+ * 
+ * return:                        Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Received no data =>                -1
+ *  Datagram was larger than buffer => -2
+ */
+int urecvfrom(int sockfd, char* bytes, int *bytes_size, struct sockaddr_storage *addr, socklen_t *addr_size)
+{
+	ssize_t received;
+	
+	if(addr_size != NULL) *addr_size = sizeof *addr;
+	do
+	{
+		received = recvfrom(sockfd, bytes, *bytes_size, MSG_TRUNC, (struct sockaddr*)addr, addr ? addr_size : NULL);
+	}while(received == -1 && errno == EINTR);
+	if(received == -1)
+	{
+		*bytes_size = 0;
+		return -1;
+	}
+	if(received > *bytes_size)
+	{
+		*bytes_size = (int)received;
+		return -2;
+	}
+	*bytes_size = (int)received;
+	return 0;
+}
+
+
+#define URECV_ERRS (2)
+#define URECV_ERR_NODATA (-1)
+#define URECV_ERR_NODATA_STR "Received no data"
+#define URECV_ERR_TRUNC (-2)
+#define URECV_ERR_TRUNC_STR "Datagram was larger than buffer"
+
+#define URECV_ERR__STR(err) ((err == URECV_ERR_NODATA) ? URECV_ERR_NODATA_STR : (err == URECV_ERR_TRUNC) ? URECV_ERR_TRUNC_STR : "")
+
+/**
+ * Receives a single datagram via UDP into a caller owned buffer.
+ * 
+ * int sockfd:      Socket on which packets are received (e.g. from ucreate_host)
+ * char* bytes:     Pointer to the bytes where the received datagram will be written
+ * int *bytes_size: Number of bytes allocated at [bytes]. Will be set to size of the datagram!
+ * 
+ * return:          Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Received no data =>                -1
+ *  Datagram was larger than buffer => -2
+ */
+int urecv(int sockfd, char* bytes, int *bytes_size)
+{
+	return urecvfrom(sockfd, bytes, bytes_size, NULL, NULL);
+}
+
+
+#define URECV_SIZE_ERRS (1)
+#define URECV_SIZE_ERR_NODATA (-1)
+#define URECV_SIZE_ERR_NODATA_STR "Received no data"
+
+#define URECV_SIZE_ERR__STR(err) ((err == URECV_SIZE_ERR_NODATA) ? URECV_SIZE_ERR_NODATA_STR : "")
+
+/**
+ * Returns the size of the next queued datagram without consuming it (blocks like urecv).
+ * 
+ * int sockfd: Socket on which packets are received (e.g. from ucreate_host)
+ * 
+ * return:     Returns size of the next datagram and error code upon failure
+ * 
+ * {error codes}:
+ *  Received no data => -1
+ */
+int urecv_size(int sockfd)
+{
+	ssize_t size;
+	char probe;
+	
+	do
+	{
+		size = recv(sockfd, &probe, 1, MSG_PEEK | MSG_TRUNC);
+	}while(size == -1 && errno == EINTR);
+	if(size == -1)
+	{
+		return -1;
+	}
+	return (int)size;
+}
+
+
+/*
+Batched UDP:
+	usend_batch and urecv_batch move many datagrams per syscall (sendmmsg / recvmmsg).
+	Buffers are owned by the caller, every packet carries its own target / source address.
+*/
+
+#define UBATCH_MAX (64)
+
+struct upacket
+{
+	char *data;
+	int size;
+	int len;
+	int truncated;
+	struct sockaddr_storage addr;
+	socklen_t addr_size;
+};
+
+
+#define USEND_BATCH_ERRS (1)
+#define USEND_BATCH_ERR_SEND (-1)
+#define USEND_BATCH_ERR_SEND_STR "Unable to send data"
+
+#define USEND_BATCH_ERR__STR(err) ((err == USEND_BATCH_ERR_SEND) ? USEND_BATCH_ERR_SEND_STR : "")
+
+/**
+ * Sends multiple datagrams via UDP with as few syscalls as possible.
+ * 
+ * int sockfd:                  Socket over which packets will be send (e.g. from usock or ucreate_host)
+ * struct addrinfo *targetinfo: Target of all packets (as returned by usock or usock_cached) or NULL to send every packet to its own [addr]
+ * struct upacket *pkts:        Packets to send ([data] and [size] set, [addr] and [addr_size] set if [targetinfo] is NULL)
+ * int pkts_count:              Number of entries in [pkts]
+ * 
+ * return:                      Returns number of packets sent (might be less than [pkts_count]) and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to send data => -1
+ */
+int usend_batch(int sockfd, struct addrinfo *targetinfo, struct upacket *pkts, int pkts_count)
+{
+	struct mmsghdr msgs[UBATCH_MAX];
+	struct iovec iovs[UBATCH_MAX];
+	int done = 0;
+	
+	while(done < pkts_count)
+	{
+		int chunk = (pkts_count - done > UBATCH_MAX) ? UBATCH_MAX : pkts_count - done;
+		int i, sent;
+		
+		memset(msgs, 0, chunk * sizeof *msgs);
+		for(i = 0; i < chunk; i++)
+		{
+			struct upacket *pkt = &pkts[done + i];
+			
+			iovs[i].iov_base = pkt->data;
+			iovs[i].iov_len = pkt->size;
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_name = targetinfo ? (void*)targetinfo->ai_addr : (void*)&pkt->addr;
+			msgs[i].msg_hdr.msg_namelen = targetinfo ? targetinfo->ai_addrlen : pkt->addr_size;
+		}
+		
+		if((sent = sendmmsg(sockfd, msgs, chunk, 0)) == -1)
+		{
+			if(errno == EINTR) continue;
+			return (done > 0) ? done : -1;
+		}
+		for(i = 0; i < sent; i++)
+		{
+			pkts[done + i].len = (int)msgs[i].msg_len;
+		}
+		done += sent;
+		if(sent < chunk) break;
+	}
+	return done;
+}
+
+
+#define URECV_BATCH_ERRS (1)
+#define URECV_BATCH_ERR_RECV (-1)
+#define URECV_BATCH_ERR_RECV_STR "Unable to receive data"
+
+#define URECV_BATCH_ERR__STR(err) ((err == URECV_BATCH_ERR_RECV) ? URECV_BATCH_ERR_RECV_STR : "")
+
+/**
+ * Receives multiple datagrams via UDP with a single syscall.
+ * Blocks until at least one datagram arrived (unless the socket is non-blocking), then takes whatever else is already queued.
+ * 
+ * int sockfd:           Socket on which packets are received (e.g. from ucreate_host)
+ * struct upacket *pkts: Packets to receive into ([data] and [size] set). [len], [truncated], [addr] and [addr_size] will be set.
+ * int pkts_count:       Number of entries in [pkts] (at most UBATCH_MAX are filled per call)
+ * 
+ * return:               Returns number of packets received (0 if a non-blocking socket had no data) and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to receive data => -1
+ */
+int urecv_batch(int sockfd, struct upacket *pkts, int pkts_count)
+{
+	struct mmsghdr msgs[UBATCH_MAX];
+	struct iovec iovs[UBATCH_MAX];
+	int i, received;
+	
+	if(pkts_count > UBATCH_MAX) pkts_count = UBATCH_MAX;
+	memset(msgs, 0, pkts_count * sizeof *msgs);
+	for(i = 0; i < pkts_count; i++)
+	{
+		iovs[i].iov_base = pkts[i].data;
+		iovs[i].iov_len = pkts[i].size;
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_name = &pkts[i].addr;
+		msgs[i].msg_hdr.msg_namelen = sizeof pkts[i].addr;
+	}
+	
+	do
+	{
+		received = recvmmsg(sockfd, msgs, pkts_count, MSG_WAITFORONE, NULL);
+	}while(received == -1 && errno == EINTR);
+	if(received == -1)
+	{
+		return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+	}
+	for(i = 0; i < received; i++)
+	{
+		pkts[i].len = (int)msgs[i].msg_len;
+		pkts[i].truncated = (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) ? 1 : 0;
+		pkts[i].addr_size = msgs[i].msg_hdr.msg_namelen;
+	}
+	return received;
+}
+
+#define USEND_ONCE_ERRS (3)
+#define USEND_ONCE_ERR_ADDR (-1)
+#define USEND_ONCE_ERR_ADDR_STR "Unable to resolve address"
+#define USEND_ONCE_ERR_SOCK (-2)
+#define USEND_ONCE_ERR_SOCK_STR "Unable to set up socket"
+#define USEND_ONCE_ERR_SEND (-3)
+#define USEND_ONCE_ERR_SEND_STR "Unable to send data"
+
+#define USEND_ONCE_ERR__STR(err) ((err == USEND_ONCE_ERR_ADDR) ? USEND_ONCE_ERR_ADDR_STR : (err == USEND_ONCE_ERR_SOCK) ? USEND_ONCE_ERR_SOCK_STR : (err == USEND_ONCE_ERR_SEND) ? USEND_ONCE_ERR_SEND_STR : "")
+
+/**
+ * Send UDP packet to target host and return bytes sent.
+ * 
+ * const char* target:      IP or web address of host to send to (e.g. "192.168.0.1", "www.example.com")
+ * const char* target_port: Port to send to at target (e.g. "80", "1729")
+ * const char* data:        Pointer to data which will be send
+ * const int DATA_SIZE:     Size of [data] memory block
+ * 
+ * return:                  Returns bytes sent (might not be equal to DATA_SIZE). Returns error code upon failure (error codes below)
+ * 
+ * {error codes}:
+ *  Unable to resolve address => -1
+ *  Unable to set up socket =>   -2
+ *  Unable to send data =>       -3
+ */
+int usend_once(const char* target, const char* target_port, const char* data, const int DATA_SIZE)
+{
+	struct addrinfo *servinfo;
+	struct sockaddr_storage addr;
+	socklen_t addr_size;
+	int sockfd;
+	int retbytes;
+	
+	if(dns_numeric(target, target_port, &addr, &addr_size) == 0)
+	{
+		// Literal address: no resolver, no allocation
+		if((sockfd = socket(addr.ss_family, SOCK_DGRAM, 0)) == -1)
+		{
+			return -2;
+		}
+		retbytes = sendto(sockfd, data, DATA_SIZE, 0, (struct sockaddr*)&addr, addr_size);
+		close(sockfd);
+		return (retbytes == -1) ? -3 : retbytes;
+	}
+	
+	if(dns_lookup(target, target_port, SOCK_DGRAM, 0, &servinfo) != 0)
+	{
+		return -1;
+	}
+	if((sockfd = socket(servinfo->ai_family, servinfo->ai_socktype, servinfo->ai_protocol)) == -1)
+	{
+		dns_release(servinfo);
+		return -2;
+	}
+	if((retbytes = sendto(sockfd, data, DATA_SIZE, 0, servinfo->ai_addr, servinfo->ai_addrlen)) == -1)
+	{
+		close(sockfd);
+		dns_release(servinfo);
+		return -3;
+	}
+	dns_release(servinfo);
+	close(sockfd);
+	return retbytes;
+}
+
+
+#define UCREATE_HOST_EX_ERRS (4)
+#define UCREATE_HOST_EX_ERR_ADDR (-1)
+#define UCREATE_HOST_EX_ERR_ADDR_STR "Unable to resolve address"
+#define UCREATE_HOST_EX_ERR_FD (-2)
+#define UCREATE_HOST_EX_ERR_FD_STR "Unable to set up files descriptor"
+#define UCREATE_HOST_EX_ERR_PORT (-3)
+#define UCREATE_HOST_EX_ERR_PORT_STR "Unable to bind to port"
+#define UCREATE_HOST_EX_ERR_FPORT (-4)
+#define UCREATE_HOST_EX_ERR_FPORT_STR "Unable to force bind to port"
+
+#define UCREATE_HOST_EX_ERR__STR(err) ((err == UCREATE_HOST_EX_ERR_ADDR) ? UCREATE_HOST_EX_ERR_ADDR_STR : (err == UCREATE_HOST_EX_ERR_FD) ? UCREATE_HOST_EX_ERR_FD_STR : (err == UCREATE_HOST_EX_ERR_PORT) ? UCREATE_HOST_EX_ERR_PORT_STR : (err == UCREATE_HOST_EX_ERR_FPORT) ? UCREATE_HOST_EX_ERR_FPORT_STR : "")
+
+/**
+ * Creates a UDP host on port [PORT] like ucreate_host, with additional options.
+ * 
+ * const char* PORT: The port on which to listen for incoming connections (as a C string [a.k.a. char pointer])
+ * int flags:        HOST_* flags (0 behaves like ucreate_host):
+ *                    HOST_REUSEPORT: Allow multiple sockets to bind the same port (SO_REUSEPORT), the kernel spreads incoming traffic across them
+ *                    HOST_DUALSTACK: Bind one IPv6 socket with IPV6_V6ONLY disabled, which serves IPv4 and IPv6 clients alike
+ * 
+ * return:           Returns UNIX file descriptor on which one can listen for & accept incomming connections. Returns error code upon failure (error codes below)
+ * 
+ * {error codes}:
+ *  Unable to resolve address =>                                     -1
+ *  Unable to set up UNIX files descriptor =>                        -2
+ *  Unable to bind to port =>                                        -3
+ *  Unable to force bind to port (Enable reuse of address / port) => -4
+ */
+int ucreate_host_ex(const char* PORT, int flags)
+{
+	int retfd;
+	struct addrinfo *servinfo, *ai;
+	
+	if(dns_lookup(NULL, PORT, SOCK_DGRAM, AI_PASSIVE, &servinfo) != 0)
+	{
+		return -1;
+	}
+	
+	ai = servinfo;
+	if(flags & HOST_DUALSTACK)
+	{
+		// A single IPv6 wildcard socket accepting IPv4 clients too (as IPv4 mapped addresses)
+		for(ai = servinfo; ai != NULL && ai->ai_family != AF_INET6; ai = ai->ai_next);
+		if(ai == NULL) ai = servinfo;
+	}
+	
+	if((retfd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) == -1)
+	{
+		dns_release(servinfo);
+		return -2;
+	}
+	
+	int yes = 1;
+	if (setsockopt(retfd,SOL_SOCKET,SO_REUSEADDR,&yes,sizeof(int)) == -1)
+	{
+		close(retfd);
+		dns_release(servinfo);
+		return -4;
+	}
+	
+	if((flags & HOST_REUSEPORT) && setsockopt(retfd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(int)) == -1)
+	{
+		close(retfd);
+		dns_release(servinfo);
+		return -4;
+	}
+	
+	int no = 0;
+	if(ai->ai_family == AF_INET6 && (flags & HOST_DUALSTACK) && setsockopt(retfd, IPPROTO_IPV6, IPV6_V6ONLY, &no, sizeof(int)) == -1)
+	{
+		close(retfd);
+		dns_release(servinfo);
+		return -2;
+	}
+	
+	if(bind(retfd, ai->ai_addr, ai->ai_addrlen) == -1)
+	{
+		close(retfd);
+		dns_release(servinfo);
+		return -3;
+	}
+	
+	dns_release(servinfo);
+	
+	return retfd;
+}
+
+
+#define UCREATE_HOST_ERRS (4)
+#define UCREATE_HOST_ERR_ADDR (-1)
+#define UCREATE_HOST_ERR_ADDR_STR "Unable to resolve address"
+#define UCREATE_HOST_ERR_FD (-2)
+#define UCREATE_HOST_ERR_FD_STR "Unable to set up files descriptor"
+#define UCREATE_HOST_ERR_PORT (-3)
+#define UCREATE_HOST_ERR_PORT_STR "Unable to bind to port"
+#define UCREATE_HOST_ERR_FPORT (-4)
+#define UCREATE_HOST_ERR_FPORT_STR "Unable to force bind to port"
+
+#define UCREATE_HOST_ERR__STR(err) ((err == UCREATE_HOST_ERR_ADDR) ? UCREATE_HOST_ERR_ADDR : (err == UCREATE_HOST_ERR_FD) ? UCREATE_HOST_ERR_FD_STR :(err == UCREATE_HOST_ERR_PORT) ? UCREATE_HOST_ERR_PORT_STR : (err == UCREATE_HOST_ERR_FPORT) ? UCREATE_HOST_ERR_FPORT_STR : "")
+
+/**
+ * Creates a UDP host on port [PORT] and returns UNIX file descriptor.
+ * 
+ * const char* PORT: The port on which to listen for incoming connections (as a C string [a.k.a. char pointer])
+ * 
+ * return:           Returns UNIX file descriptor on which one can listen for & accept incomming connections. Returns error code upon failure (error codes below)
+ * 
+ * {error codes}:
+ *  Unable to resolve address =>                           -1
+ *  Unable to set up UNIX files descriptor =>              -2
+ *  Unable to bind to port =>                              -3
+ *  Unable to force bind to port (Enable reuse of port) => -4
+ */
+int ucreate_host(const char* PORT)
+{
+	return ucreate_host_ex(PORT, 0);
+}
+
+
+static int host__create_all(int socktype, const char* PORT, int *fds, int max_fds, int flags)
+{
+	struct addrinfo *servinfo, *ai;
+	int count = 0, yes = 1, err = 0;
+	
+	if(dns_lookup(NULL, PORT, socktype, AI_PASSIVE, &servinfo) != 0)
+	{
+		return -1;
+	}
+	for(ai = servinfo; ai != NULL && count < max_fds; ai = ai->ai_next)
+	{
+		int fd;
+		
+		if((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) == -1)
+		{
+			err = -2;
+			break;
+		}
+		if(setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(int)) == -1
+			|| ((flags & HOST_REUSEPORT) && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(int)) == -1))
+		{
+			close(fd);
+			err = -4;
+			break;
+		}
+		// The IPv4 wildcard gets its own socket, keep the IPv6 one from claiming it as well
+		if(ai->ai_family == AF_INET6 && setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &yes, sizeof(int)) == -1)
+		{
+			close(fd);
+			err = -2;
+			break;
+		}
+		if(bind(fd, ai->ai_addr, ai->ai_addrlen) == -1)
+		{
+			close(fd);
+			err = -3;
+			break;
+		}
+		fds[count++] = fd;
+	}
+	dns_release(servinfo);
+	if(err < 0)
+	{
+		while(count-- > 0) close(fds[count]);
+		return err;
+	}
+	return count;
+}
+
+
+#define TCREATE_HOSTS_ERRS (4)
+#define TCREATE_HOSTS_ERR_ADDR (-1)
+#define TCREATE_HOSTS_ERR_ADDR_STR "Unable to resolve address"
+#define TCREATE_HOSTS_ERR_FD (-2)
+#define TCREATE_HOSTS_ERR_FD_STR "Unable to set up files descriptor"
+#define TCREATE_HOSTS_ERR_PORT (-3)
+#define TCREATE_HOSTS_ERR_PORT_STR "Unable to bind to port"
+#define TCREATE_HOSTS_ERR_FPORT (-4)
+#define TCREATE_HOSTS_ERR_FPORT_STR "Unable to force bind to port"
+
+#define TCREATE_HOSTS_ERR__STR(err) ((err == TCREATE_HOSTS_ERR_ADDR) ? TCREATE_HOSTS_ERR_ADDR_STR : (err == TCREATE_HOSTS_ERR_FD) ? TCREATE_HOSTS_ERR_FD_STR : (err == TCREATE_HOSTS_ERR_PORT) ? TCREATE_HOSTS_ERR_PORT_STR : (err == TCREATE_HOSTS_ERR_FPORT) ? TCREATE_HOSTS_ERR_FPORT_STR : "")
+
+/**
+ * Creates a TCP host on port [PORT] for every local wildcard address (e.g. one for IPv4 and one for IPv6).
+ * Register every returned file descriptor (e.g. with tlistener_create and reactor_add) to serve clients of all address families.
+ * 
+ * const char* PORT: The port on which to listen for incoming connections
+ * int *fds:         Array in which the UNIX file descriptors of the hosts will be saved
+ * int max_fds:      Number of entries in [fds]
+ * int flags:        HOST_REUSEPORT or 0 (see tcreate_host_ex)
+ * 
+ * return:           Returns number of hosts created and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to resolve address =>                                     -1
+ *  Unable to set up UNIX files descriptor =>                        -2
+ *  Unable to bind to port =>                                        -3
+ *  Unable to force bind to port (Enable reuse of address / port) => -4
+ */
+int tcreate_hosts(const char* PORT, int *fds, int max_fds, int flags)
+{
+	return host__create_all(SOCK_STREAM, PORT, fds, max_fds, flags);
+}
+
+
+#define UCREATE_HOSTS_ERRS (4)
+#define UCREATE_HOSTS_ERR_ADDR (-1)
+#define UCREATE_HOSTS_ERR_ADDR_STR "Unable to resolve address"
+#define UCREATE_HOSTS_ERR_FD (-2)
+#define UCREATE_HOSTS_ERR_FD_STR "Unable to set up files descriptor"
+#define UCREATE_HOSTS_ERR_PORT (-3)
+#define UCREATE_HOSTS_ERR_PORT_STR "Unable to bind to port"
+#define UCREATE_HOSTS_ERR_FPORT (-4)
+#define UCREATE_HOSTS_ERR_FPORT_STR "Unable to force bind to port"
+
+#define UCREATE_HOSTS_ERR__STR(err) ((err == UCREATE_HOSTS_ERR_ADDR) ? UCREATE_HOSTS_ERR_ADDR_STR : (err == UCREATE_HOSTS_ERR_FD) ? UCREATE_HOSTS_ERR_FD_STR : (err == UCREATE_HOSTS_ERR_PORT) ? UCREATE_HOSTS_ERR_PORT_STR : (err == UCREATE_HOSTS_ERR_FPORT) ? UCREATE_HOSTS_ERR_FPORT_STR : "")
+
+/**
+ * Creates a UDP host on port [PORT] for every local wildcard address (e.g. one for IPv4 and one for IPv6).
+ * 
+ * const char* PORT: The port on which to receive datagrams
+ * int *fds:         Array in which the UNIX file descriptors of the hosts will be saved
+ * int max_fds:      Number of entries in [fds]
+ * int flags:        HOST_REUSEPORT or 0 (see ucreate_host_ex)
+ * 
+ * return:           Returns number of hosts created and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to resolve address =>                                     -1
+ *  Unable to set up UNIX files descriptor =>                        -2
+ *  Unable to bind to port =>                                        -3
+ *  Unable to force bind to port (Enable reuse of address / port) => -4
+ */
+int ucreate_hosts(const char* PORT, int *fds, int max_fds, int flags)
+{
+	return host__create_all(SOCK_DGRAM, PORT, fds, max_fds, flags);
+}
+
+/*
+Sharding:
+	tcreate_shards / ucreate_shards bind [count] SO_REUSEPORT sockets to the same port, one per worker thread.
+	Each socket has its own accept / receive queue, so workers don't contend on a single socket.
+	With [steer] set, a socket is selected by the CPU which received the packet (shard i <=> CPU i % count),
+	so a worker pinned to CPU i with pin_cpu handles the connections whose packets that CPU processed.
+	The steering program picks a socket by its position in the reuseport group, which is the order the sockets
+	joined it: binding for UDP, listening for TCP. tcreate_shards therefore returns hosts which listen already,
+	in the order of [fds], and attaches the program only afterwards.
+*/
+
+static int host__shards(int (*create)(const char*, int), const char* PORT, int *fds, int count, int steer, int backlog)
+{
+	int i;
+	
+	for(i = 0; i < count; i++)
+	{
+		if((fds[i] = create(PORT, HOST_REUSEPORT)) < 0)
+		{
+			int err = fds[i];
+			
+			while(i-- > 0) close(fds[i]);
+			return err;
+		}
+	}
+	for(i = 0; i < count && backlog > 0; i++)
+	{
+		if(listen(fds[i], backlog) == -1)
+		{
+			for(i = 0; i < count; i++) close(fds[i]);
+			return -6;
+		}
+	}
+	if(steer)
+	{
+		// Return the receiving CPU modulo the number of shards as index into the reuseport group
+		struct sock_filter code[3];
+		struct sock_fprog prog;
+		
+		code[0].code = BPF_LD | BPF_W | BPF_ABS;
+		code[0].jt = code[0].jf = 0;
+		code[0].k = (unsigned int)(SKF_AD_OFF + SKF_AD_CPU);
+		code[1].code = BPF_ALU | BPF_MOD | BPF_K;
+		code[1].jt = code[1].jf = 0;
+		code[1].k = (unsigned int)count;
+		code[2].code = BPF_RET | BPF_A;
+		code[2].jt = code[2].jf = 0;
+		code[2].k = 0;
+		prog.len = 3;
+		prog.filter = code;
+		if(setsockopt(fds[0], SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof prog) == -1)
+		{
+			for(i = 0; i < count; i++) close(fds[i]);
+			return -5;
+		}
+	}
+	return 0;
+}
+
+
+#define TCREATE_SHARDS_ERRS (6)
+#define TCREATE_SHARDS_ERR_ADDR (-1)
+#define TCREATE_SHARDS_ERR_ADDR_STR "Unable to resolve address"
+#define TCREATE_SHARDS_ERR_FD (-2)
+#define TCREATE_SHARDS_ERR_FD_STR "Unable to set up files descriptor"
+#define TCREATE_SHARDS_ERR_PORT (-3)
+#define TCREATE_SHARDS_ERR_PORT_STR "Unable to bind to port"
+#define TCREATE_SHARDS_ERR_FPORT (-4)
+#define TCREATE_SHARDS_ERR_FPORT_STR "Unable to force bind to port"
+#define TCREATE_SHARDS_ERR_STEER (-5)
+#define TCREATE_SHARDS_ERR_STEER_STR "Unable to steer connections by CPU"
+#define TCREATE_SHARDS_ERR_LISTEN (-6)
+#define TCREATE_SHARDS_ERR_LISTEN_STR "Unable to listen on port"
+
+#define TCREATE_SHARDS_ERR__STR(err) ((err == TCREATE_SHARDS_ERR_ADDR) ? TCREATE_SHARDS_ERR_ADDR_STR : (err == TCREATE_SHARDS_ERR_FD) ? TCREATE_SHARDS_ERR_FD_STR : (err == TCREATE_SHARDS_ERR_PORT) ? TCREATE_SHARDS_ERR_PORT_STR : (err == TCREATE_SHARDS_ERR_FPORT) ? TCREATE_SHARDS_ERR_FPORT_STR : (err == TCREATE_SHARDS_ERR_STEER) ? TCREATE_SHARDS_ERR_STEER_STR : (err == TCREATE_SHARDS_ERR_LISTEN) ? TCREATE_SHARDS_ERR_LISTEN_STR : "")
+
+/**
+ * Creates [count] TCP hosts sharing port [PORT] (SO_REUSEPORT), one for every worker thread.
+ * The hosts already listen (with a backlog of SOMAXCONN), calling listen again only changes the backlog.
+ * 
+ * const char* PORT: The port on which to listen for incoming connections
+ * int *fds:         Array in which the UNIX file descriptors of the hosts will be saved
+ * int count:        Number of hosts to create (entries in [fds])
+ * int steer:        1 to hand connections to host i % count if CPU i received them, 0 to let the kernel hash them across hosts
+ * 
+ * return:           Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to resolve address =>                                     -1
+ *  Unable to set up UNIX files descriptor =>                        -2
+ *  Unable to bind to port =>                                        -3
+ *  Unable to force bind to port (Enable reuse of address / port) => -4
+ *  Unable to steer connections by CPU =>                            -5
+ *  Unable to listen on port =>                                      -6
+ */
+int tcreate_shards(const char* PORT, int *fds, int count, int steer)
+{
+	return host__shards(tcreate_host_ex, PORT, fds, count, steer, SOMAXCONN);
+}
+
+
+#define UCREATE_SHARDS_ERRS (5)
+#define UCREATE_SHARDS_ERR_ADDR (-1)
+#define UCREATE_SHARDS_ERR_ADDR_STR "Unable to resolve address"
+#define UCREATE_SHARDS_ERR_FD (-2)
+#define UCREATE_SHARDS_ERR_FD_STR "Unable to set up files descriptor"
+#define UCREATE_SHARDS_ERR_PORT (-3)
+#define UCREATE_SHARDS_ERR_PORT_STR "Unable to bind to port"
+#define UCREATE_SHARDS_ERR_FPORT (-4)
+#define UCREATE_SHARDS_ERR_FPORT_STR "Unable to force bind to port"
+#define UCREATE_SHARDS_ERR_STEER (-5)
+#define UCREATE_SHARDS_ERR_STEER_STR "Unable to steer datagrams by CPU"
+
+#define UCREATE_SHARDS_ERR__STR(err) ((err == UCREATE_SHARDS_ERR_ADDR) ? UCREATE_SHARDS_ERR_ADDR_STR : (err == UCREATE_SHARDS_ERR_FD) ? UCREATE_SHARDS_ERR_FD_STR : (err == UCREATE_SHARDS_ERR_PORT) ? UCREATE_SHARDS_ERR_PORT_STR : (err == UCREATE_SHARDS_ERR_FPORT) ? UCREATE_SHARDS_ERR_FPORT_STR : (err == UCREATE_SHARDS_ERR_STEER) ? UCREATE_SHARDS_ERR_STEER_STR : "")
+
+/**
+ * Creates [count] UDP hosts sharing port [PORT] (SO_REUSEPORT), one for every worker thread.
+ * 
+ * const char* PORT: The port on which to receive datagrams
+ * int *fds:         Array in which the UNIX file descriptors of the hosts will be saved
+ * int count:        Number of hosts to create (entries in [fds])
+ * int steer:        1 to hand datagrams to host i % count if CPU i received them, 0 to let the kernel hash them across hosts
+ * 
+ * return:           Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to resolve address =>                                     -1
+ *  Unable to set up UNIX files descriptor =>                        -2
+ *  Unable to bind to port =>                                        -3
+ *  Unable to force bind to port (Enable reuse of address / port) => -4
+ *  Unable to steer datagrams by CPU =>                              -5
+ */
+int ucreate_shards(const char* PORT, int *fds, int count, int steer)
+{
+	return host__shards(ucreate_host_ex, PORT, fds, count, steer, 0);
+}
+
+
+#define PIN_CPU_ERRS (1)
+#define PIN_CPU_ERR_AFFINITY (-1)
+#define PIN_CPU_ERR_AFFINITY_STR "Unable to set CPU affinity"
+
+#define PIN_CPU_ERR__STR(err) ((err == PIN_CPU_ERR_AFFINITY) ? PIN_CPU_ERR_AFFINITY_STR : "")
+
+/**
+ * Pins the calling thread to a single CPU.
+ * 
+ * int cpu: Number of the CPU to run on (e.g. the shard index)
+ * 
+ * return:  Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to set CPU affinity => -1
+ */
+int pin_cpu(int cpu)
+{
+	cpu_set_t set;
+	
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if(pthread_setaffinity_np(pthread_self(), sizeof set, &set) != 0)
+	{
+		return -1;
+	}
+	return 0;
+}
+
+
+/*
+Reactor:
+	An epoll based readiness loop. Any file descriptor (e.g. from tconnect, tcreate_host or ucreate_host)
+	can be registered together with a callback, which is invoked from reactor_run / reactor_run_once
+	whenever the file descriptor becomes ready.
+	Events are the usual epoll flags (EPOLLIN, EPOLLOUT, EPOLLRDHUP, ...). Adding EPOLLET registers
+	the file descriptor edge-triggered, otherwise it is level-triggered.
+	Callbacks may add, modify or delete any file descriptor (including their own) while being dispatched.
+*/
+
+#define REACTOR_MAX_EVENTS (256)
+
+struct reactor;
+
+typedef void (*reactor_cb)(struct reactor *r, int fd, unsigned int events, void *arg);
+
+struct reactor_slot
+{
+	reactor_cb cb;
+	void *arg;
+	unsigned int gen;
+	int timer;
+};
+
+/* Intrusive work item for reactor_post, usually embedded into a bigger struct */
+struct reactor_task
+{
+	void (*fn)(struct reactor_task *t);
+	struct reactor_task *next;
+};
+
+struct reactor
+{
+	int epfd;
+	int running;
+	struct reactor_slot *slots;
+	int slots_size;
+	int post_fd;
+	struct reactor_task *posted;
+	struct epoll_event events[REACTOR_MAX_EVENTS];
+};
+
+int reactor_add(struct reactor *r, int fd, unsigned int events, reactor_cb cb, void *arg);
+
+/* Runs tasks posted from other threads, in the order they were posted */
+static void reactor__on_post(struct reactor *r, int fd, unsigned int events, void *arg)
+{
+	struct reactor_task *t, *next, *fifo = NULL;
+	uint64_t count;
+	
+	(void)events;
+	(void)arg;
+	if(read(fd, &count, sizeof count) == -1 && errno != EAGAIN) return;
+	t = __atomic_exchange_n(&r->posted, (struct reactor_task*)NULL, __ATOMIC_ACQUIRE);
+	for(; t != NULL; t = next)
+	{
+		next = t->next;
+		t->next = fifo;
+		fifo = t;
+	}
+	for(t = fifo; t != NULL; t = next)
+	{
+		next = t->next;
+		t->fn(t);
+	}
+}
+
+
+#define REACTOR_CREATE_ERRS (2)
+#define REACTOR_CREATE_ERR_EPOLL (-1)
+#define REACTOR_CREATE_ERR_EPOLL_STR "Unable to set up epoll instance"
+#define REACTOR_CREATE_ERR_POST (-2)
+#define REACTOR_CREATE_ERR_POST_STR "Unable to set up wakeup file descriptor"
+
+#define REACTOR_CREATE_ERR__STR(err) ((err == REACTOR_CREATE_ERR_EPOLL) ? REACTOR_CREATE_ERR_EPOLL_STR : (err == REACTOR_CREATE_ERR_POST) ? REACTOR_CREATE_ERR_POST_STR : "")
+
+/**
+ * Sets up a reactor.
+ * 
+ * struct reactor *r: Pointer to the reactor to initialize
+ * 
+ * return:            Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to set up epoll instance =>         -1
+ *  Unable to set up wakeup file descriptor => -2
+ */
+int reactor_create(struct reactor *r)
+{
+	memset(r, 0, sizeof *r);
+	r->post_fd = -1;
+	if((r->epfd = epoll_create1(EPOLL_CLOEXEC)) == -1)
+	{
+		return -1;
+	}
+	if((r->post_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1 ||
+		reactor_add(r, r->post_fd, EPOLLIN, reactor__on_post, NULL) < 0)
+	{
+		// Leave the reactor in a state reactor_destroy and the epfd checks of callers cope with
+		if(r->post_fd >= 0) close(r->post_fd);
+		close(r->epfd);
+		free(r->slots);
+		r->epfd = r->post_fd = -1;
+		r->slots = NULL;
+		r->slots_size = 0;
+		return -2;
+	}
+	return 0;
+}
+
+
+#define REACTOR_ADD_ERRS (2)
+#define REACTOR_ADD_ERR_MEM (-1)
+#define REACTOR_ADD_ERR_MEM_STR "Unable to allocate memory"
+#define REACTOR_ADD_ERR_CTL (-2)
+#define REACTOR_ADD_ERR_CTL_STR "Unable to register file descriptor"
+
+#define REACTOR_ADD_ERR__STR(err) ((err == REACTOR_ADD_ERR_MEM) ? REACTOR_ADD_ERR_MEM_STR : (err == REACTOR_ADD_ERR_CTL) ? REACTOR_ADD_ERR_CTL_STR : "")
+
+/**
+ * Registers a file descriptor with the reactor.
+ * 
+ * struct reactor *r:   Reactor to register with
+ * int fd:              UNIX file descriptor to watch
+ * unsigned int events: epoll events to watch for (e.g. EPOLLIN, EPOLLIN | EPOLLOUT | EPOLLET)
+ * reactor_cb cb:       Callback invoked with the ready events
+ * void *arg:           Pointer handed to [cb] untouched
+ * 
+ * return:              Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to allocate memory =>          -1
+ *  Unable to register file descriptor => -2
+ */
+int reactor_add(struct reactor *r, int fd, unsigned int events, reactor_cb cb, void *arg)
+{
+	struct epoll_event ev;
+	
+	// e.g. an error code of tconnect passed on unchecked
+	if(fd < 0)
+	{
+		return -2;
+	}
+	if(fd >= r->slots_size)
+	{
+		int new_size = r->slots_size ? r->slots_size : 64;
+		struct reactor_slot *new_slots;
+		
+		while(new_size <= fd) new_size *= 2;
+		if((new_slots = (struct reactor_slot*)realloc(r->slots, new_size * sizeof *new_slots)) == NULL)
+		{
+			return -1;
+		}
+		memset(new_slots + r->slots_size, 0, (new_size - r->slots_size) * sizeof *new_slots);
+		r->slots = new_slots;
+		r->slots_size = new_size;
+	}
+	
+	memset(&ev, 0, sizeof ev);
+	ev.events = events;
+	ev.data.u64 = ((uint64_t)r->slots[fd].gen << 32) | (uint32_t)fd;
+	if(epoll_ctl(r->epfd, EPOLL_CTL_ADD, fd, &ev) == -1)
+	{
+		return -2;
+	}
+	r->slots[fd].cb = cb;
+	r->slots[fd].arg = arg;
+	r->slots[fd].timer = 0;
+	return 0;
+}
+
+
+#define REACTOR_MOD_ERRS (1)
+#define REACTOR_MOD_ERR_CTL (-1)
+#define REACTOR_MOD_ERR_CTL_STR "Unable to modify file descriptor"
+
+#define REACTOR_MOD_ERR__STR(err) ((err == REACTOR_MOD_ERR_CTL) ? REACTOR_MOD_ERR_CTL_STR : "")
+
+/**
+ * Changes the events watched for on an already registered file descriptor.
+ * 
+ * struct reactor *r:   Reactor the file descriptor is registered with
+ * int fd:              Registered UNIX file descriptor
+ * unsigned int events: New epoll events to watch for
+ * 
+ * return:              Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to modify file descriptor => -1
+ */
+int reactor_mod(struct reactor *r, int fd, unsigned int events)
+{
+	struct epoll_event ev;
+	
+	if(fd < 0 || fd >= r->slots_size || r->slots[fd].cb == NULL)
+	{
+		return -1;
+	}
+	memset(&ev, 0, sizeof ev);
+	ev.events = events;
+	ev.data.u64 = ((uint64_t)r->slots[fd].gen << 32) | (uint32_t)fd;
+	if(epoll_ctl(r->epfd, EPOLL_CTL_MOD, fd, &ev) == -1)
+	{
+		return -1;
+	}
+	return 0;
+}
+
+
+#define REACTOR_DEL_ERRS (1)
+#define REACTOR_DEL_ERR_CTL (-1)
+#define REACTOR_DEL_ERR_CTL_STR "Unable to unregister file descriptor"
+
+#define REACTOR_DEL_ERR__STR(err) ((err == REACTOR_DEL_ERR_CTL) ? REACTOR_DEL_ERR_CTL_STR : "")
+
+/**
+ * Unregisters a file descriptor from the reactor. Pending events for it are dropped.
+ * The file descriptor itself is not closed.
+ * 
+ * struct reactor *r: Reactor the file descriptor is registered with
+ * int fd:            Registered UNIX file descriptor
+ * 
+ * return:            Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to unregister file descriptor => -1
+ */
+int reactor_del(struct reactor *r, int fd)
+{
+	if(fd < 0 || fd >= r->slots_size || r->slots[fd].cb == NULL)
+	{
+		return -1;
+	}
+	r->slots[fd].cb = NULL;
+	r->slots[fd].arg = NULL;
+	r->slots[fd].timer = 0;
+	r->slots[fd].gen++;
+	if(epoll_ctl(r->epfd, EPOLL_CTL_DEL, fd, NULL) == -1)
+	{
+		return -1;
+	}
+	return 0;
+}
+
+
+#define REACTOR_ADD_TIMER_ERRS (2)
+#define REACTOR_ADD_TIMER_ERR_TIMER (-1)
+#define REACTOR_ADD_TIMER_ERR_TIMER_STR "Unable to set up timer"
+#define REACTOR_ADD_TIMER_ERR_ADD (-2)
+#define REACTOR_ADD_TIMER_ERR_ADD_STR "Unable to register timer"
+
+#define REACTOR_ADD_TIMER_ERR__STR(err) ((err == REACTOR_ADD_TIMER_ERR_TIMER) ? REACTOR_ADD_TIMER_ERR_TIMER_STR : (err == REACTOR_ADD_TIMER_ERR_ADD) ? REACTOR_ADD_TIMER_ERR_ADD_STR : "")
+
+/**
+ * Registers a one shot timer with the reactor (backed by a timerfd).
+ * [cb] is invoked once with the timer's file descriptor after [delay_us] passed. The timer is removed
+ * and closed right before, so the callback must not use the file descriptor.
+ * 
+ * struct reactor *r: Reactor to register with
+ * long delay_us:     Delay in microseconds
+ * reactor_cb cb:     Callback invoked once the timer expired
+ * void *arg:         Pointer handed to [cb] untouched
+ * 
+ * return:            Returns the file descriptor identifying the timer (for reactor_del_timer) and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to set up timer =>  -1
+ *  Unable to register timer => -2
+ */
+int reactor_add_timer(struct reactor *r, long delay_us, reactor_cb cb, void *arg)
+{
+	struct itimerspec its;
+	int tfd;
+	
+	if((tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) == -1)
+	{
+		return -1;
+	}
+	memset(&its, 0, sizeof its);
+	if(delay_us < 1) delay_us = 1;
+	its.it_value.tv_sec = delay_us / 1000000;
+	its.it_value.tv_nsec = (delay_us % 1000000) * 1000;
+	if(timerfd_settime(tfd, 0, &its, NULL) == -1)
+	{
+		close(tfd);
+		return -1;
+	}
+	if(reactor_add(r, tfd, EPOLLIN, cb, arg) < 0)
+	{
+		close(tfd);
+		return -2;
+	}
+	r->slots[tfd].timer = 1;
+	return tfd;
+}
+
+
+#define REACTOR_DEL_TIMER_ERRS (1)
+#define REACTOR_DEL_TIMER_ERR_TIMER (-1)
+#define REACTOR_DEL_TIMER_ERR_TIMER_STR "No such timer"
+
+#define REACTOR_DEL_TIMER_ERR__STR(err) ((err == REACTOR_DEL_TIMER_ERR_TIMER) ? REACTOR_DEL_TIMER_ERR_TIMER_STR : "")
+
+/**
+ * Cancels a timer which did not fire yet.
+ * 
+ * struct reactor *r: Reactor the timer is registered with
+ * int tfd:           File descriptor returned by reactor_add_timer
+ * 
+ * return:            Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  No such timer => -1
+ */
+int reactor_del_timer(struct reactor *r, int tfd)
+{
+	if(tfd < 0 || tfd >= r->slots_size || r->slots[tfd].cb == NULL || !r->slots[tfd].timer)
+	{
+		return -1;
+	}
+	reactor_del(r, tfd);
+	close(tfd);
+	return 0;
+}
+
+
+#define REACTOR_RUN_ONCE_ERRS (1)
+#define REACTOR_RUN_ONCE_ERR_WAIT (-1)
+#define REACTOR_RUN_ONCE_ERR_WAIT_STR "Unable to wait for events"
+
+#define REACTOR_RUN_ONCE_ERR__STR(err) ((err == REACTOR_RUN_ONCE_ERR_WAIT) ? REACTOR_RUN_ONCE_ERR_WAIT_STR : "")
+
+/**
+ * Waits once for events and dispatches them to their callbacks.
+ * 
+ * struct reactor *r: Reactor to run
+ * int timeout_ms:    Maximum time to wait in milliseconds (-1 to wait forever, 0 to only poll)
+ * 
+ * return:            Returns the number of events dispatched and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to wait for events => -1
+ */
+int reactor_run_once(struct reactor *r, int timeout_ms)
+{
+	int n, i, dispatched = 0;
+	
+	if((n = epoll_wait(r->epfd, r->events, REACTOR_MAX_EVENTS, timeout_ms)) == -1)
+	{
+		return (errno == EINTR) ? 0 : -1;
+	}
+	for(i = 0; i < n; i++)
+	{
+		int fd = (int)(uint32_t)r->events[i].data.u64;
+		unsigned int gen = (unsigned int)(r->events[i].data.u64 >> 32);
+		
+		// Skip events of file descriptors deleted (or replaced) by an earlier callback
+		if(fd >= r->slots_size || r->slots[fd].cb == NULL || r->slots[fd].gen != gen) continue;
+		if(r->slots[fd].timer)
+		{
+			// Timers fire once, the slot is released before the callback runs
+			reactor_cb cb = r->slots[fd].cb;
+			void *arg = r->slots[fd].arg;
+			
+			reactor_del_timer(r, fd);
+			cb(r, fd, r->events[i].events, arg);
+		}
+		else
+		{
+			r->slots[fd].cb(r, fd, r->events[i].events, r->slots[fd].arg);
+		}
+		dispatched++;
+	}
+	return dispatched;
+}
+
+
+#define REACTOR_RUN_ERRS (1)
+#define REACTOR_RUN_ERR_WAIT (-1)
+#define REACTOR_RUN_ERR_WAIT_STR "Unable to wait for events"
+
+#define REACTOR_RUN_ERR__STR(err) ((err == REACTOR_RUN_ERR_WAIT) ? REACTOR_RUN_ERR_WAIT_STR : "")
+
+/**
+ * Dispatches events until reactor_stop is called (usually from within a callback).
+ * 
+ * struct reactor *r: Reactor to run
+ * 
+ * return:            Returns 0 once stopped and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to wait for events => -1
+ */
+int reactor_run(struct reactor *r)
+{
+	r->running = 1;
+	while(r->running)
+	{
+		if(reactor_run_once(r, -1) < 0)
+		{
+			r->running = 0;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+#define REACTOR_STOP_ERRS (0)
+#define REACTOR_STOP_ERR__STR(err) ""
+
+/**
+ * Makes reactor_run return after the current batch of events.
+ * 
+ */
+void reactor_stop(struct reactor *r)
+{
+	r->running = 0;
+}
+
+#define REACTOR_DESTROY_ERRS (0)
+#define REACTOR_DESTROY_ERR__STR(err) ""
+
+/**
+ * Frees all resources held by the reactor. Registered file descriptors are not closed.
+ * 
+ */
+void reactor_destroy(struct reactor *r)
+{
+	if(r->post_fd >= 0) close(r->post_fd);
+	if(r->epfd >= 0) close(r->epfd);
+	free(r->slots);
+	r->epfd = r->post_fd = -1;
+	r->slots = NULL;
+	r->slots_size = 0;
+}
+
+
+
+#define REACTOR_POST_ERRS (1)
+#define REACTOR_POST_ERR_WAKE (-1)
+#define REACTOR_POST_ERR_WAKE_STR "Unable to wake up reactor"
+
+#define REACTOR_POST_ERR__STR(err) ((err == REACTOR_POST_ERR_WAKE) ? REACTOR_POST_ERR_WAKE_STR : "")
+
+/**
+ * Hands a task to the reactor's thread. Can be called from any thread, t->fn is invoked from reactor_run / reactor_run_once.
+ * 
+ * struct reactor *r:      Reactor to run the task on
+ * struct reactor_task *t: Task with [fn] set. Must stay valid until [fn] was invoked.
+ * 
+ * return:                 Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to wake up reactor => -1
+ */
+int reactor_post(struct reactor *r, struct reactor_task *t)
+{
+	uint64_t one = 1;
+	struct reactor_task *head = __atomic_load_n(&r->posted, __ATOMIC_RELAXED);
+	
+	do
+	{
+		t->next = head;
+	}while(!__atomic_compare_exchange_n(&r->posted, &head, t, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+	// Only the first task of a batch needs to wake the reactor
+	if(head == NULL && write(r->post_fd, &one, sizeof one) == -1)
+	{
+		return -1;
+	}
+	return 0;
+}
+
+
+/*
+Output coalescing:
+	Collects the small writes of a response (header, body, trailer, ...) in a per-connection buffer and sends
+	them with a single tsendv, i.e. one syscall and as few segments as possible. The buffer is flushed
+	  - explicitly with tout_flush (e.g. at the end of a response),
+	  - as soon as [threshold] bytes are buffered,
+	  - [deadline_us] microseconds after the first unflushed write (needs a reactor), so nothing waits for long.
+	    Every output buffer keeps one timerfd registered with the reactor, which is only re-armed per response.
+	Writes which don't fit into the buffer are sent right away together with the buffered bytes, without copying them.
+	With TOUT_CORK the socket is corked (TCP_CORK) instead of only buffering: big writes go out as full
+	segments and the partial tail is pushed by the next flush, flushes toggle the cork.
+*/
+
+#define TOUT_CORK (1)
+
+struct tout
+{
+	int fd;
+	int flags;
+	char *buf;
+	int buf_size;
+	int used;
+	int threshold;
+	struct reactor *r;
+	long deadline_us;
+	int timer;
+	int armed;
+	int error;
+};
+
+
+#define TOUT_CREATE_ERRS (4)
+#define TOUT_CREATE_ERR_ARG (-1)
+#define TOUT_CREATE_ERR_ARG_STR "Invalid buffer parameters"
+#define TOUT_CREATE_ERR_MEM (-2)
+#define TOUT_CREATE_ERR_MEM_STR "Unable to allocate buffer"
+#define TOUT_CREATE_ERR_CORK (-3)
+#define TOUT_CREATE_ERR_CORK_STR "Unable to cork socket"
+#define TOUT_CREATE_ERR_TIMER (-4)
+#define TOUT_CREATE_ERR_TIMER_STR "Unable to set up flush deadline"
+
+#define TOUT_CREATE_ERR__STR(err) ((err == TOUT_CREATE_ERR_ARG) ? TOUT_CREATE_ERR_ARG_STR : (err == TOUT_CREATE_ERR_MEM) ? TOUT_CREATE_ERR_MEM_STR : (err == TOUT_CREATE_ERR_CORK) ? TOUT_CREATE_ERR_CORK_STR : (err == TOUT_CREATE_ERR_TIMER) ? TOUT_CREATE_ERR_TIMER_STR : "")
+
+static void tout__on_deadline(struct reactor *r, int fd, unsigned int events, void *arg);
+
+/**
+ * Sets up an output buffer for a connection.
+ * 
+ * struct tout *o:    Pointer to the output buffer to initialize
+ * int targetfd:      UNIX file descriptor of target (With TCP connection established)
+ * int buf_size:      Size of the buffer in bytes
+ * int threshold:     Number of buffered bytes at which the buffer is flushed (at most [buf_size])
+ * struct reactor *r: Reactor for the flush deadline (NULL to only flush explicitly or by size)
+ * long deadline_us:  Maximum time in microseconds a write stays buffered (ignored without [r])
+ * int flags:         0 or TOUT_CORK
+ * 
+ * return:            Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Invalid buffer parameters =>       -1
+ *  Unable to allocate buffer =>       -2
+ *  Unable to cork socket =>           -3
+ *  Unable to set up flush deadline => -4
+ */
+int tout_create(struct tout *o, int targetfd, int buf_size, int threshold, struct reactor *r, long deadline_us, int flags)
+{
+	int one = 1;
+	
+	memset(o, 0, sizeof *o);
+	if(buf_size < 1 || threshold < 1 || threshold > buf_size || (r != NULL && deadline_us < 1))
+	{
+		return -1;
+	}
+	if((o->buf = (char*)malloc(buf_size)) == NULL)
+	{
+		return -2;
+	}
+	if((flags & TOUT_CORK) && setsockopt(targetfd, IPPROTO_TCP, TCP_CORK, &one, sizeof one) == -1)
+	{
+		free(o->buf);
+		o->buf = NULL;
+		return -3;
+	}
+	o->fd = targetfd;
+	o->flags = flags;
+	o->buf_size = buf_size;
+	o->threshold = threshold;
+	o->r = r;
+	o->deadline_us = deadline_us;
+	o->timer = -1;
+	if(r != NULL)
+	{
+		if((o->timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) == -1
+			|| reactor_add(r, o->timer, EPOLLIN, tout__on_deadline, o) < 0)
+		{
+			if(o->timer >= 0) close(o->timer);
+			o->timer = -1;
+			free(o->buf);
+			o->buf = NULL;
+			return -4;
+		}
+	}
+	return 0;
+}
+
+/* Arms ([delay_us] > 0) or disarms (0) the flush deadline */
+static int tout__arm(struct tout *o, long delay_us)
+{
+	struct itimerspec its;
+	
+	memset(&its, 0, sizeof its);
+	its.it_value.tv_sec = delay_us / 1000000;
+	its.it_value.tv_nsec = (delay_us % 1000000) * 1000;
+	if(timerfd_settime(o->timer, 0, &its, NULL) == -1)
+	{
+		return -1;
+	}
+	o->armed = (delay_us > 0);
+	return 0;
+}
+
+/* Sends the buffered bytes followed by [data] (may be NULL) with one tsendv */
+static int tout__send(struct tout *o, const char *data, int size)
+{
+	struct iovec iov[2];
+	int n = 0;
+	
+	if(o->used > 0)
+	{
+		iov[n].iov_base = o->buf;
+		iov[n].iov_len = o->used;
+		n++;
+	}
+	if(size > 0)
+	{
+		iov[n].iov_base = (void*)data;
+		iov[n].iov_len = size;
+		n++;
+	}
+	o->used = 0;
+	if(n > 0 && tsendv(o->fd, iov, n, NULL) < 0)
+	{
+		o->error = -1;
+		return -1;
+	}
+	return 0;
+}
+
+
+#define TOUT_FLUSH_ERRS (1)
+#define TOUT_FLUSH_ERR_SEND (-1)
+#define TOUT_FLUSH_ERR_SEND_STR "Unable to send data"
+
+#define TOUT_FLUSH_ERR__STR(err) ((err == TOUT_FLUSH_ERR_SEND) ? TOUT_FLUSH_ERR_SEND_STR : "")
+
+/**
+ * Sends everything buffered right away (and pushes out the partial segment when corked).
+ * 
+ * struct tout *o: Output buffer to flush
+ * 
+ * return:         Returns 0 upon success and error code upon failure (also if a deadline flush failed before)
+ * 
+ * {error codes}:
+ *  Unable to send data => -1
+ */
+int tout_flush(struct tout *o)
+{
+	int zero = 0, one = 1;
+	
+	if(o->armed) tout__arm(o, 0);
+	if(o->error != 0 || tout__send(o, NULL, 0) < 0)
+	{
+		return -1;
+	}
+	if(o->flags & TOUT_CORK)
+	{
+		// Removing the cork sends the pending partial segment
+		setsockopt(o->fd, IPPROTO_TCP, TCP_CORK, &zero, sizeof zero);
+		setsockopt(o->fd, IPPROTO_TCP, TCP_CORK, &one, sizeof one);
+	}
+	return 0;
+}
+
+static void tout__on_deadline(struct reactor *r, int fd, unsigned int events, void *arg)
+{
+	struct tout *o = (struct tout*)arg;
+	uint64_t expirations;
+	
+	(void)r;
+	(void)events;
+	// Nothing read means the deadline was disarmed (or re-armed) after it fired
+	if(read(fd, &expirations, sizeof expirations) != (ssize_t)sizeof expirations) return;
+	o->armed = 0;
+	tout_flush(o);
+}
+
+
+#define TOUT_WRITE_ERRS (3)
+#define TOUT_WRITE_ERR_SEND (-1)
+#define TOUT_WRITE_ERR_SEND_STR "Unable to send data"
+#define TOUT_WRITE_ERR_TIMER (-2)
+#define TOUT_WRITE_ERR_TIMER_STR "Unable to set up flush deadline"
+#define TOUT_WRITE_ERR_SIZE (-3)
+#define TOUT_WRITE_ERR_SIZE_STR "Invalid data size"
+
+#define TOUT_WRITE_ERR__STR(err) ((err == TOUT_WRITE_ERR_SEND) ? TOUT_WRITE_ERR_SEND_STR : (err == TOUT_WRITE_ERR_TIMER) ? TOUT_WRITE_ERR_TIMER_STR : (err == TOUT_WRITE_ERR_SIZE) ? TOUT_WRITE_ERR_SIZE_STR : "")
+
+/**
+ * Queues data for sending. Flushes if the threshold is reached, otherwise arms the flush deadline.
+ * 
+ * struct tout *o:   Output buffer to write to
+ * const char *data: Data to send ([data] is not used anymore after returning)
+ * int size:         Number of bytes to send
+ * 
+ * return:           Returns 0 upon success and error code upon failure (also if a deadline flush failed before)
+ * 
+ * {error codes}:
+ *  Unable to send data =>             -1
+ *  Unable to set up flush deadline => -2
+ *  Invalid data size =>               -3
+ */
+int tout_write(struct tout *o, const char *data, int size)
+{
+	if(size < 0)
+	{
+		return -3;
+	}
+	if(o->error != 0)
+	{
+		return -1;
+	}
+	if(size > o->buf_size - o->used)
+	{
+		// Does not fit: send it along with the buffered bytes instead of copying
+		if(tout__send(o, data, size) < 0)
+		{
+			return -1;
+		}
+	}
+	else
+	{
+		memcpy(o->buf + o->used, data, size);
+		o->used += size;
+	}
+	
+	if(o->used >= o->threshold || (o->used == 0 && !(o->flags & TOUT_CORK)))
+	{
+		return tout_flush(o);
+	}
+	if(o->timer >= 0 && !o->armed && tout__arm(o, o->deadline_us) < 0)
+	{
+		return -2;
+	}
+	return 0;
+}
+
+#define TOUT_DESTROY_ERRS (0)
+#define TOUT_DESTROY_ERR__STR(err) ""
+
+/**
+ * Cancels the flush deadline and frees the buffer. Buffered bytes are dropped, call tout_flush first.
+ * 
+ */
+void tout_destroy(struct tout *o)
+{
+	if(o->timer >= 0)
+	{
+		reactor_del(o->r, o->timer);
+		close(o->timer);
+		o->timer = -1;
+	}
+	o->armed = 0;
+	free(o->buf);
+	o->buf = NULL;
+	o->used = 0;
+}
+
+/*
+Relay:
+	Forwards a TCP connection to another one (e.g. one from tlisten_accept to one from tconnect) in both directions.
+	Data moves with splice through a kernel pipe per direction, it is never copied into user memory.
+	The relay registers both file descriptors with a reactor and reports through its callback:
+		TRELAY_EOF_A  [fd_a] finished sending, the write side of [fd_b] has been shut down
+		TRELAY_EOF_B  [fd_b] finished sending, the write side of [fd_a] has been shut down
+		TRELAY_DONE   Both directions finished or one failed (t->error). The file descriptors are removed from the reactor
+		              but stay open. The relay may be freed from within this call.
+	t->bytes[0] counts the bytes relayed from [fd_a] to [fd_b], t->bytes[1] the other direction.
+*/
+
+#define TRELAY_EOF_A (1)
+#define TRELAY_EOF_B (2)
+#define TRELAY_DONE (3)
+
+#define TRELAY_PIPE_SIZE (1 << 20)
+
+struct trelay;
+
+typedef void (*trelay_cb)(struct trelay *t, int event, void *arg);
+
+struct trelay_dir
+{
+	int from;
+	int to;
+	int pipefd[2];
+	int pending;
+	int eof;
+	int shut;
+};
+
+struct trelay
+{
+	struct reactor *r;
+	struct trelay_dir dir[2];
+	long long bytes[2];
+	int error;
+	int active;
+	trelay_cb cb;
+	void *arg;
+};
+
+/* Moves data in direction [d] until both ends would block. Returns 1 when the direction just shut down, 0 otherwise and -1 upon failure */
+static int trelay__pump(struct trelay *t, int d)
+{
+	struct trelay_dir *dir = &t->dir[d];
+	ssize_t n;
+	
+	for(;;)
+	{
+		if(dir->pending > 0)
+		{
+			if((n = splice(dir->pipefd[0], NULL, dir->to, NULL, dir->pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK)) == -1)
+			{
+				if(errno == EINTR) continue;
+				return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+			}
+			dir->pending -= (int)n;
+			t->bytes[d] += n;
+			continue;
+		}
+		if(dir->eof)
+		{
+			if(dir->shut) return 0;
+			shutdown(dir->to, SHUT_WR);
+			dir->shut = 1;
+			return 1;
+		}
+		// The pipe is empty here, so EAGAIN can only mean the source has no data
+		if((n = splice(dir->from, NULL, dir->pipefd[1], NULL, TRELAY_PIPE_SIZE, SPLICE_F_MOVE | SPLICE_F_NONBLOCK)) == -1)
+		{
+			if(errno == EINTR) continue;
+			return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+		}
+		if(n == 0) dir->eof = 1;
+		dir->pending += (int)n;
+	}
+}
+
+#define TRELAY_STOP_ERRS (0)
+#define TRELAY_STOP_ERR__STR(err) ""
+
+/**
+ * Stops relaying without closing the file descriptors. Bytes still buffered in the pipes are dropped.
+ * 
+ */
+void trelay_stop(struct trelay *t)
+{
+	int d;
+	
+	if(!t->active) return;
+	t->active = 0;
+	reactor_del(t->r, t->dir[0].from);
+	reactor_del(t->r, t->dir[1].from);
+	for(d = 0; d < 2; d++)
+	{
+		close(t->dir[d].pipefd[0]);
+		close(t->dir[d].pipefd[1]);
+	}
+}
+
+static void trelay__on_event(struct reactor *r, int fd, unsigned int events, void *arg)
+{
+	struct trelay *t = (struct trelay*)arg;
+	int d, ret;
+	
+	(void)r;
+	(void)fd;
+	(void)events;
+	// Edge triggered: any readiness change on either side pumps both directions until they block
+	for(d = 0; d < 2 && t->error == 0; d++)
+	{
+		if((ret = trelay__pump(t, d)) < 0)
+		{
+			t->error = -1;
+		}
+		else if(ret == 1)
+		{
+			t->cb(t, (d == 0) ? TRELAY_EOF_A : TRELAY_EOF_B, t->arg);
+		}
+	}
+	if(t->error != 0 || (t->dir[0].shut && t->dir[1].shut))
+	{
+		trelay_stop(t);
+		t->cb(t, TRELAY_DONE, t->arg);
+	}
+}
+
+
+#define TRELAY_START_ERRS (2)
+#define TRELAY_START_ERR_PIPE (-1)
+#define TRELAY_START_ERR_PIPE_STR "Unable to set up pipes"
+#define TRELAY_START_ERR_REACTOR (-2)
+#define TRELAY_START_ERR_REACTOR_STR "Unable to register with reactor"
+
+#define TRELAY_START_ERR__STR(err) ((err == TRELAY_START_ERR_PIPE) ? TRELAY_START_ERR_PIPE_STR : (err == TRELAY_START_ERR_REACTOR) ? TRELAY_START_ERR_REACTOR_STR : "")
+
+/**
+ * Starts relaying between two connected sockets. Both are switched to non-blocking and must not be registered with [r] yet.
+ * 
+ * struct trelay *t:  Pointer to the relay to initialize (must stay valid until TRELAY_DONE or trelay_stop)
+ * struct reactor *r: Reactor driving the relay
+ * int fd_a:          UNIX file descriptor of the first connection
+ * int fd_b:          UNIX file descriptor of the second connection
+ * trelay_cb cb:      Callback invoked on half-close and when the relay is done
+ * void *arg:         Pointer handed to [cb] untouched
+ * 
+ * return:            Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to set up pipes =>          -1
+ *  Unable to register with reactor => -2
+ */
+int trelay_start(struct trelay *t, struct reactor *r, int fd_a, int fd_b, trelay_cb cb, void *arg)
+{
+	int d;
+	
+	memset(t, 0, sizeof *t);
+	t->r = r;
+	t->cb = cb;
+	t->arg = arg;
+	t->dir[0].from = t->dir[1].to = fd_a;
+	t->dir[0].to = t->dir[1].from = fd_b;
+	for(d = 0; d < 2; d++)
+	{
+		if(pipe2(t->dir[d].pipefd, O_NONBLOCK | O_CLOEXEC) == -1)
+		{
+			if(d == 1)
+			{
+				close(t->dir[0].pipefd[0]);
+				close(t->dir[0].pipefd[1]);
+			}
+			return -1;
+		}
+		fcntl(t->dir[d].pipefd[1], F_SETPIPE_SZ, TRELAY_PIPE_SIZE);
+	}
+	t->active = 1;
+	set_nonblock(fd_a, 1);
+	set_nonblock(fd_b, 1);
+	if(reactor_add(r, fd_a, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, trelay__on_event, t) < 0 ||
+		reactor_add(r, fd_b, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, trelay__on_event, t) < 0)
+	{
+		trelay_stop(t);
+		return -2;
+	}
+	return 0;
+}
+
+/*
+Server runtime:
+	A shared-nothing TCP server with one worker thread per shard. Every worker owns a SO_REUSEPORT listener
+	(see tcreate_shards), a reactor, a receive buffer and a connection table and is pinned to its own CPU,
+	so workers never share locks or cache lines on the hot path. Handlers run on the worker owning the connection:
+		on_accept(c, arg)              New connection (may be NULL)
+		on_data(c, data, size, arg)    Data received. [data] points into the worker's receive buffer and is only valid during the call
+		on_close(c, arg)               Connection closed by the peer or with tserver_close (may be NULL)
+	[arg] is the handler's [arg] member, handed to every call untouched.
+	Replies are sent from within the handlers, e.g. tsend(c->fd, ...). struct tserver_conn pointers are only valid
+	during a handler call, keep per-connection state in c->user.
+*/
+
+#define TSERVER_ACCEPT_BATCH (64)
+
+struct tserver;
+struct tserver_worker;
+
+struct tserver_conn
+{
+	int fd;
+	int open;
+	struct tserver_worker *worker;
+	struct sockaddr_storage addr;
+	void *user;
+};
+
+struct tserver_handler
+{
+	void (*on_accept)(struct tserver_conn *c, void *arg);
+	void (*on_data)(struct tserver_conn *c, char *data, int size, void *arg);
+	void (*on_close)(struct tserver_conn *c, void *arg);
+	void *arg;
+};
+
+struct tserver_worker
+{
+	int index;
+	int cpu;
+	pthread_t thread;
+	struct reactor r;
+	struct tlistener l;
+	int stop_fd;
+	struct tserver_conn *conns;
+	int conns_size;
+	char *buf;
+	int buf_size;
+	const struct tserver_handler *handler;
+	struct tserver *srv;
+	unsigned long accepted;
+};
+
+struct tserver
+{
+	struct tserver_worker *workers;
+	int count;
+};
+
+#define TSERVER_CLOSE_ERRS (0)
+#define TSERVER_CLOSE_ERR__STR(err) ""
+
+/**
+ * Closes a connection of the server from within a handler. on_close is invoked before the file descriptor is closed.
+ * 
+ */
+void tserver_close(struct tserver_conn *c)
+{
+	struct tserver_worker *w = c->worker;
+	int fd = c->fd;
+	
+	if(!c->open) return;
+	c->open = 0;
+	if(w->handler->on_close != NULL) w->handler->on_close(c, w->handler->arg);
+	reactor_del(&w->r, fd);
+	close(fd);
+	c->user = NULL;
+}
+
+static void tserver__on_conn(struct reactor *r, int fd, unsigned int events, void *arg)
+{
+	struct tserver_worker *w = (struct tserver_worker*)arg;
+	struct tserver_conn *c = &w->conns[fd];
+	ssize_t received;
+	
+	(void)r;
+	if(events & EPOLLIN)
+	{
+		do
+		{
+			received = recv(fd, w->buf, w->buf_size, 0);
+		}while(received == -1 && errno == EINTR);
+		if(received > 0)
+		{
+			w->handler->on_data(c, w->buf, (int)received, w->handler->arg);
+			return;
+		}
+		if(received == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+	}
+	tserver_close(c);
+}
+
+static void tserver__on_listener(struct reactor *r, int fd, unsigned int events, void *arg)
+{
+	struct tserver_worker *w = (struct tserver_worker*)arg;
+	struct sockaddr_storage addrs[TSERVER_ACCEPT_BATCH];
+	int fds[TSERVER_ACCEPT_BATCH];
+	int n, i;
+	
+	(void)fd;
+	(void)events;
+	while((n = tlistener_accept_batch(&w->l, fds, addrs, TSERVER_ACCEPT_BATCH)) > 0)
+	{
+		for(i = 0; i < n; i++)
+		{
+			struct tserver_conn *c;
+			
+			if(fds[i] >= w->conns_size)
+			{
+				int new_size = w->conns_size ? w->conns_size : 64;
+				struct tserver_conn *new_conns;
+				
+				while(new_size <= fds[i]) new_size *= 2;
+				if((new_conns = (struct tserver_conn*)realloc(w->conns, new_size * sizeof *new_conns)) == NULL)
+				{
+					close(fds[i]);
+					continue;
+				}
+				memset(new_conns + w->conns_size, 0, (new_size - w->conns_size) * sizeof *new_conns);
+				w->conns = new_conns;
+				w->conns_size = new_size;
+			}
+			c = &w->conns[fds[i]];
+			c->fd = fds[i];
+			c->open = 1;
+			c->worker = w;
+			c->addr = addrs[i];
+			c->user = NULL;
+			if(reactor_add(r, fds[i], EPOLLIN | EPOLLRDHUP, tserver__on_conn, w) < 0)
+			{
+				c->open = 0;
+				close(fds[i]);
+				continue;
+			}
+			w->accepted++;
+			if(w->handler->on_accept != NULL) w->handler->on_accept(c, w->handler->arg);
+		}
+		if(n < TSERVER_ACCEPT_BATCH) break;
+	}
+}
+
+static void tserver__on_stop(struct reactor *r, int fd, unsigned int events, void *arg)
+{
+	(void)fd;
+	(void)events;
+	(void)arg;
+	reactor_stop(r);
+}
+
+static void *tserver__worker(void *arg)
+{
+	struct tserver_worker *w = (struct tserver_worker*)arg;
+	int fd;
+	
+	if(w->cpu >= 0) pin_cpu(w->cpu);
+	reactor_run(&w->r);
+	
+	for(fd = 0; fd < w->conns_size; fd++)
+	{
+		if(w->conns[fd].open) tserver_close(&w->conns[fd]);
+	}
+	return NULL;
+}
+
+static void tserver__free_worker(struct tserver_worker *w)
+{
+	if(w->r.epfd >= 0) reactor_destroy(&w->r);
+	if(w->l.fd >= 0) tlistener_close(&w->l);
+	if(w->stop_fd >= 0) close(w->stop_fd);
+	free(w->conns);
+	free(w->buf);
+}
+
+#define TSERVER_STOP_ERRS (0)
+#define TSERVER_STOP_ERR__STR(err) ""
+
+/**
+ * Stops all workers, closes all connections (invoking on_close) and frees the server.
+ * Must not be called from a handler.
+ * 
+ */
+void tserver_stop(struct tserver *srv)
+{
+	uint64_t one = 1;
+	int i;
+	
+	for(i = 0; i < srv->count; i++)
+	{
+		if(write(srv->workers[i].stop_fd, &one, sizeof one) == -1) continue;
+	}
+	for(i = 0; i < srv->count; i++)
+	{
+		pthread_join(srv->workers[i].thread, NULL);
+		tserver__free_worker(&srv->workers[i]);
+	}
+	free(srv->workers);
+	srv->workers = NULL;
+	srv->count = 0;
+}
+
+
+#define TSERVER_START_ERRS (4)
+#define TSERVER_START_ERR_HOST (-1)
+#define TSERVER_START_ERR_HOST_STR "Unable to create hosts"
+#define TSERVER_START_ERR_MEM (-2)
+#define TSERVER_START_ERR_MEM_STR "Unable to allocate memory"
+#define TSERVER_START_ERR_REACTOR (-3)
+#define TSERVER_START_ERR_REACTOR_STR "Unable to set up reactor"
+#define TSERVER_START_ERR_THREAD (-4)
+#define TSERVER_START_ERR_THREAD_STR "Unable to start worker thread"
+
+#define TSERVER_START_ERR__STR(err) ((err == TSERVER_START_ERR_HOST) ? TSERVER_START_ERR_HOST_STR : (err == TSERVER_START_ERR_MEM) ? TSERVER_START_ERR_MEM_STR : (err == TSERVER_START_ERR_REACTOR) ? TSERVER_START_ERR_REACTOR_STR : (err == TSERVER_START_ERR_THREAD) ? TSERVER_START_ERR_THREAD_STR : "")
+
+/**
+ * Starts a server on port [PORT] with one worker thread per shard. Returns once all workers run.
+ * 
+ * struct tserver *srv:                Pointer to the server to initialize
+ * const char* PORT:                   The port on which to listen for incoming connections
+ * int workers:                        Number of workers (0 for one per online CPU)
+ * const struct tserver_handler *h:    Handlers invoked for connections (must stay valid until tserver_stop)
+ * int buf_size:                       Size of every worker's receive buffer
+ * 
+ * return:                             Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to create hosts =>        -1
+ *  Unable to allocate memory =>     -2
+ *  Unable to set up reactor =>      -3
+ *  Unable to start worker thread => -4
+ */
+int tserver_start(struct tserver *srv, const char* PORT, int workers, const struct tserver_handler *h, int buf_size)
+{
+	int cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	int *fds;
+	int i, started;
+	
+	if(cpus < 1) cpus = 1;
+	if(workers < 1) workers = cpus;
+	memset(srv, 0, sizeof *srv);
+	if((fds = (int*)malloc(workers * sizeof *fds)) == NULL)
+	{
+		return -2;
+	}
+	// Steering by CPU only lines up with the workers if there is one per CPU
+	if(tcreate_shards(PORT, fds, workers, workers == cpus) < 0)
+	{
+		free(fds);
+		return -1;
+	}
+	if((srv->workers = (struct tserver_worker*)calloc(workers, sizeof *srv->workers)) == NULL)
+	{
+		for(i = 0; i < workers; i++) close(fds[i]);
+		free(fds);
+		return -2;
+	}
+	srv->count = workers;
+	
+	for(i = 0; i < workers; i++)
+	{
+		struct tserver_worker *w = &srv->workers[i];
+		
+		w->index = i;
+		w->cpu = (workers == cpus) ? i : -1;
+		w->srv = srv;
+		w->handler = h;
+		w->buf_size = buf_size;
+		w->l.fd = fds[i];
+		w->stop_fd = -1;
+		w->r.epfd = -1;
+	}
+	free(fds);
+	
+	for(i = 0; i < workers; i++)
+	{
+		struct tserver_worker *w = &srv->workers[i];
+		int err = 0;
+		
+		if((w->buf = (char*)malloc(buf_size)) == NULL)
+		{
+			err = -2;
+		}
+		else if(tlistener_create(&w->l, w->l.fd, SOMAXCONN) < 0)
+		{
+			err = -1;
+		}
+		else if(reactor_create(&w->r) < 0 || (w->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1
+			|| reactor_add(&w->r, w->l.fd, EPOLLIN, tserver__on_listener, w) < 0
+			|| reactor_add(&w->r, w->stop_fd, EPOLLIN, tserver__on_stop, w) < 0)
+		{
+			err = -3;
+		}
+		if(err < 0)
+		{
+			for(i = 0; i < workers; i++) tserver__free_worker(&srv->workers[i]);
+			free(srv->workers);
+			srv->workers = NULL;
+			srv->count = 0;
+			return err;
+		}
+	}
+	
+	for(started = 0; started < workers; started++)
+	{
+		if(pthread_create(&srv->workers[started].thread, NULL, tserver__worker, &srv->workers[started]) != 0)
+		{
+			uint64_t one = 1;
+			
+			// Only the running workers can be joined, but all of them were set up
+			for(i = 0; i < started; i++)
+			{
+				if(write(srv->workers[i].stop_fd, &one, sizeof one) == -1) continue;
+			}
+			for(i = 0; i < started; i++) pthread_join(srv->workers[i].thread, NULL);
+			for(i = 0; i < workers; i++) tserver__free_worker(&srv->workers[i]);
+			free(srv->workers);
+			srv->workers = NULL;
+			srv->count = 0;
+			return -4;
+		}
+	}
+	return 0;
+}
+
+/*
+Work-stealing executor:
+	Runs CPU heavy parts of connection handlers (parsing, compression, ...) on a pool of worker threads,
+	so the reactor thread keeps serving I/O. Every worker owns a Chase-Lev deque: tasks posted from a worker
+	go to its own deque (LIFO, cache warm), tasks posted from other threads go to a shared injection queue,
+	and idle workers steal from the top of other workers' deques.
+	Once t->run returned, t->done is posted to the reactor t->owner, so responses are sent (e.g. with tsend)
+	from the thread owning the connection:
+		t->run = parse_and_compress; t->done = send_response; t->owner = &r;
+		wspool_post(&pool, t);
+*/
+
+struct wstask
+{
+	void (*run)(struct wstask *t);
+	void (*done)(struct wstask *t);
+	struct reactor *owner;
+	void *arg;
+	struct reactor_task completion;
+	struct wstask *next;
+};
+
+struct wsdeque
+{
+	int64_t top;
+	char pad1[64 - sizeof(int64_t)];
+	int64_t bottom;
+	char pad2[64 - sizeof(int64_t)];
+	struct wstask **buf;
+	int64_t mask;
+};
+
+struct wspool;
+
+struct wspool_worker
+{
+	struct wsdeque deque;
+	struct wspool *pool;
+	pthread_t thread;
+	unsigned int seed;
+};
+
+struct wspool
+{
+	struct wspool_worker *workers;
+	int count;
+	int started;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	struct wstask *inject_head;
+	struct wstask *inject_tail;
+	int sleeping;
+	int stop;
+};
+
+static __thread struct wspool_worker *wspool__self = NULL;
+
+static int wsdeque__push(struct wsdeque *d, struct wstask *t)
+{
+	int64_t b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED);
+	int64_t top = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+	
+	if(b - top > d->mask)
+	{
+		return -1;
+	}
+	__atomic_store_n(&d->buf[b & d->mask], t, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+	return 0;
+}
+
+static struct wstask *wsdeque__pop(struct wsdeque *d)
+{
+	int64_t b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED) - 1;
+	int64_t top;
+	struct wstask *t = NULL;
+	
+	__atomic_store_n(&d->bottom, b, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	top = __atomic_load_n(&d->top, __ATOMIC_RELAXED);
+	if(top <= b)
+	{
+		t = __atomic_load_n(&d->buf[b & d->mask], __ATOMIC_RELAXED);
+		if(top == b)
+		{
+			// Last task: race against thieves for it
+			if(!__atomic_compare_exchange_n(&d->top, &top, top + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) t = NULL;
+			__atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+		}
+	}
+	else
+	{
+		__atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+	}
+	return t;
+}
+
+static struct wstask *wsdeque__steal(struct wsdeque *d)
+{
+	int64_t top = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+	int64_t b;
+	struct wstask *t;
+	
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	b = __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE);
+	if(top >= b)
+	{
+		return NULL;
+	}
+	t = __atomic_load_n(&d->buf[top & d->mask], __ATOMIC_RELAXED);
+	if(!__atomic_compare_exchange_n(&d->top, &top, top + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+	{
+		return NULL;
+	}
+	return t;
+}
+
+static void wspool__complete(struct reactor_task *rt)
+{
+	struct wstask *t = (struct wstask*)((char*)rt - offsetof(struct wstask, completion));
+	
+	t->done(t);
+}
+
+static struct wstask *wspool__find(struct wspool_worker *w)
+{
+	struct wspool *pool = w->pool;
+	struct wstask *t;
+	int i;
+	
+	if((t = wsdeque__pop(&w->deque)) != NULL) return t;
+	
+	if(__atomic_load_n(&pool->inject_head, __ATOMIC_RELAXED) != NULL)
+	{
+		pthread_mutex_lock(&pool->lock);
+		if((t = pool->inject_head) != NULL)
+		{
+			pool->inject_head = t->next;
+			if(pool->inject_head == NULL) pool->inject_tail = NULL;
+		}
+		pthread_mutex_unlock(&pool->lock);
+		if(t != NULL) return t;
+	}
+	
+	// Steal, starting at a random victim so thieves spread out
+	w->seed = w->seed * 1103515245u + 12345u;
+	for(i = 0; i < pool->count; i++)
+	{
+		struct wspool_worker *victim = &pool->workers[(w->seed / 65536 + i) % pool->count];
+		
+		if(victim == w) continue;
+		if((t = wsdeque__steal(&victim->deque)) != NULL) return t;
+	}
+	return NULL;
+}
+
+static void *wspool__worker(void *arg)
+{
+	struct wspool_worker *w = (struct wspool_worker*)arg;
+	struct wspool *pool = w->pool;
+	struct wstask *t;
+	
+	wspool__self = w;
+	for(;;)
+	{
+		if((t = wspool__find(w)) != NULL)
+		{
+			t->run(t);
+			if(t->done != NULL && t->owner != NULL)
+			{
+				t->completion.fn = wspool__complete;
+				reactor_post(t->owner, &t->completion);
+			}
+			continue;
+		}
+		
+		pthread_mutex_lock(&pool->lock);
+		if(pool->inject_head == NULL)
+		{
+			if(pool->stop)
+			{
+				pthread_mutex_unlock(&pool->lock);
+				break;
+			}
+			pool->sleeping++;
+			pthread_cond_wait(&pool->wake, &pool->lock);
+			pool->sleeping--;
+		}
+		pthread_mutex_unlock(&pool->lock);
+	}
+	wspool__self = NULL;
+	return NULL;
+}
+
+
+#define WSPOOL_CREATE_ERRS (2)
+#define WSPOOL_CREATE_ERR_MEM (-1)
+#define WSPOOL_CREATE_ERR_MEM_STR "Unable to allocate memory"
+#define WSPOOL_CREATE_ERR_THREAD (-2)
+#define WSPOOL_CREATE_ERR_THREAD_STR "Unable to start worker thread"
+
+#define WSPOOL_CREATE_ERR__STR(err) ((err == WSPOOL_CREATE_ERR_MEM) ? WSPOOL_CREATE_ERR_MEM_STR : (err == WSPOOL_CREATE_ERR_THREAD) ? WSPOOL_CREATE_ERR_THREAD_STR : "")
+
+void wspool_destroy(struct wspool *pool);
+
+/**
+ * Starts a work-stealing executor.
+ * 
+ * struct wspool *pool: Pointer to the executor to initialize
+ * int workers:         Number of worker threads (0 for one per online CPU)
+ * int deque_size:      Capacity of every worker's deque (rounded up to a power of 2). Overflow goes to the injection queue.
+ * 
+ * return:              Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to allocate memory =>     -1
+ *  Unable to start worker thread => -2
+ */
+int wspool_create(struct wspool *pool, int workers, int deque_size)
+{
+	int64_t capacity = 16;
+	int i;
+	
+	memset(pool, 0, sizeof *pool);
+	if(workers < 1) workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if(workers < 1) workers = 1;
+	while(capacity < deque_size) capacity *= 2;
+	
+	if((pool->workers = (struct wspool_worker*)calloc(workers, sizeof *pool->workers)) == NULL)
+	{
+		return -1;
+	}
+	pool->count = workers;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+	for(i = 0; i < workers; i++)
+	{
+		struct wspool_worker *w = &pool->workers[i];
+		
+		w->pool = pool;
+		w->seed = (unsigned int)i * 2654435761u + 1;
+		w->deque.mask = capacity - 1;
+		if((w->deque.buf = (struct wstask**)calloc(capacity, sizeof *w->deque.buf)) == NULL)
+		{
+			wspool_destroy(pool);
+			return -1;
+		}
+	}
+	for(i = 0; i < workers; i++)
+	{
+		if(pthread_create(&pool->workers[i].thread, NULL, wspool__worker, &pool->workers[i]) != 0)
+		{
+			wspool_destroy(pool);
+			return -2;
+		}
+		pool->started = i + 1;
+	}
+	return 0;
+}
+
+#define WSPOOL_POST_ERRS (0)
+#define WSPOOL_POST_ERR__STR(err) ""
+
+/**
+ * Queues a task. From a worker thread the task goes to that worker's own deque, otherwise to the injection queue.
+ * 
+ * struct wspool *pool: Executor to run the task on
+ * struct wstask *t:    Task with [run] set, [done] and [owner] set to get a completion on a reactor. Must stay valid until it completed.
+ */
+void wspool_post(struct wspool *pool, struct wstask *t)
+{
+	struct wspool_worker *self = wspool__self;
+	
+	// A full deque spills into the injection queue. A sleeper racing with this push at worst
+	// leaves the task to its owner, which always drains its own deque before sleeping.
+	if(self != NULL && self->pool == pool && wsdeque__push(&self->deque, t) == 0)
+	{
+		if(__atomic_load_n(&pool->sleeping, __ATOMIC_RELAXED) > 0) pthread_cond_signal(&pool->wake);
+		return;
+	}
+	t->next = NULL;
+	pthread_mutex_lock(&pool->lock);
+	if(pool->inject_tail != NULL) pool->inject_tail->next = t;
+	else pool->inject_head = t;
+	pool->inject_tail = t;
+	if(pool->sleeping > 0) pthread_cond_signal(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+#define WSPOOL_DESTROY_ERRS (0)
+#define WSPOOL_DESTROY_ERR__STR(err) ""
+
+/**
+ * Runs all queued tasks, stops the workers and frees the executor. Must not be called from a worker.
+ * 
+ */
+void wspool_destroy(struct wspool *pool)
+{
+	int i;
+	
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+	for(i = 0; i < pool->started; i++)
+	{
+		pthread_join(pool->workers[i].thread, NULL);
+	}
+	for(i = 0; i < pool->count; i++)
+	{
+		free(pool->workers[i].deque.buf);
+	}
+	free(pool->workers);
+	pool->workers = NULL;
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->wake);
+}
+
+#if defined(__cplusplus) && __cplusplus >= 202002L
+/*
+Coroutines (C++20 only):
+	Awaitable versions of tconnect, trecv, tsend and tlistener_accept_batch, driven by a reactor.
+	Every operation is tried right away and only suspends on EAGAIN, the awaitable lives inside the
+	coroutine frame and frames come from per-thread free lists, so steady state awaits never touch the heap.
+		co_task session(struct reactor *r, int fd)
+		{
+			char buf[512];
+			int n;
+			
+			while((n = co_await async_recv(r, fd, buf, sizeof buf)) > 0)
+			{
+				if(co_await async_send(r, fd, buf, n) < 0) break;
+			}
+			async_close(r, fd);
+		}
+	A file descriptor stays registered with the reactor (edge triggered) from its first suspended await until async_close,
+	so a connection costs no epoll_ctl per await. One coroutine may receive on a file descriptor while another one sends on it.
+	Close such file descriptors with async_close, a plain close would leave the reactor's slot behind for the next file
+	descriptor with that number.
+	Coroutines start eagerly and free their frame once they return. Do not destroy the reactor while one is suspended.
+*/
+#include <coroutine>
+
+#define CO_FRAME_GRANULARITY 64
+#define CO_FRAME_CLASSES 32
+
+static thread_local void *co__frames[CO_FRAME_CLASSES];
+
+/* Frames up to CO_FRAME_GRANULARITY * CO_FRAME_CLASSES bytes are recycled per thread, bigger ones go to malloc */
+static void *co__frame_alloc(size_t size) noexcept
+{
+	size_t cls = (size - 1) / CO_FRAME_GRANULARITY;
+	void *frame;
+	
+	if(cls >= CO_FRAME_CLASSES)
+	{
+		return malloc(size);
+	}
+	if((frame = co__frames[cls]) != NULL)
+	{
+		co__frames[cls] = *(void**)frame;
+		return frame;
+	}
+	return malloc((cls + 1) * CO_FRAME_GRANULARITY);
+}
+
+static void co__frame_free(void *frame, size_t size) noexcept
+{
+	size_t cls = (size - 1) / CO_FRAME_GRANULARITY;
+	
+	if(cls >= CO_FRAME_CLASSES)
+	{
+		free(frame);
+		return;
+	}
+	*(void**)frame = co__frames[cls];
+	co__frames[cls] = frame;
+}
+
+/* Return type of a coroutine. A coroutine whose frame could not be allocated never runs. */
+struct co_task
+{
+	struct promise_type
+	{
+		co_task get_return_object() noexcept { return co_task(); }
+		static co_task get_return_object_on_allocation_failure() noexcept { return co_task(); }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() noexcept {}
+		void unhandled_exception() noexcept { abort(); }
+		static void *operator new(size_t size) noexcept { return co__frame_alloc(size); }
+		static void operator delete(void *frame, size_t size) noexcept { co__frame_free(frame, size); }
+	};
+};
+
+struct co__io;
+
+/* The awaitables waiting on a file descriptor: one receiving (or accepting) and one sending (or connecting) */
+struct co__fd
+{
+	struct co__io *reader;
+	struct co__io *writer;
+};
+
+static thread_local struct co__fd *co__fds;
+static thread_local int co__fds_size;
+static thread_local int co__fds_count;
+
+static void co__on_event(struct reactor *r, int fd, unsigned int events, void *arg);
+
+static int co__registered(struct reactor *r, int fd)
+{
+	return fd >= 0 && fd < r->slots_size && r->slots[fd].cb == co__on_event;
+}
+
+/* Registers [fd] (edge triggered, for both directions) unless it already is. Returns 0 upon success and -1 upon failure */
+static int co__register(struct reactor *r, int fd)
+{
+	if(co__registered(r, fd)) return 0;
+	if(fd >= co__fds_size)
+	{
+		int new_size = co__fds_size ? co__fds_size : 64;
+		struct co__fd *new_fds;
+		
+		while(new_size <= fd) new_size *= 2;
+		if((new_fds = (struct co__fd*)realloc(co__fds, new_size * sizeof *new_fds)) == NULL)
+		{
+			return -1;
+		}
+		memset(new_fds + co__fds_size, 0, (new_size - co__fds_size) * sizeof *new_fds);
+		co__fds = new_fds;
+		co__fds_size = new_size;
+	}
+	if(reactor_add(r, fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, co__on_event, NULL) < 0)
+	{
+		return -1;
+	}
+	co__fds[fd].reader = co__fds[fd].writer = NULL;
+	co__fds_count++;
+	return 0;
+}
+
+static void co__unregister(struct reactor *r, int fd)
+{
+	if(!co__registered(r, fd)) return;
+	reactor_del(r, fd);
+	if(--co__fds_count == 0)
+	{
+		free(co__fds);
+		co__fds = NULL;
+		co__fds_size = 0;
+	}
+}
+
+/* Shared part of the awaitables: [attempt] returns 1 once the operation is done and 0 on EAGAIN */
+struct co__io
+{
+	struct reactor *r;
+	int fd;
+	unsigned int events;
+	int result;
+	int wait_err;
+	int owns_fd;
+	int (*attempt)(struct co__io *io);
+	std::coroutine_handle<> h;
+	
+	bool await_ready() noexcept
+	{
+		if(fd < 0)
+		{
+			// e.g. an error code passed on unchecked, async_connect already holds its own error code
+			if(result >= 0) result = wait_err;
+			return true;
+		}
+		return attempt(this);
+	}
+	
+	bool await_suspend(std::coroutine_handle<> handle) noexcept
+	{
+		h = handle;
+		return wait();
+	}
+	
+	int await_resume() noexcept
+	{
+		return result;
+	}
+	
+	/* Waits for [fd] to become ready for [events]. Upon failure sets the result to [wait_err] and returns false. */
+	bool wait() noexcept
+	{
+		struct co__io **waiter;
+		
+		if(co__register(r, fd) == 0)
+		{
+			waiter = (events & EPOLLOUT) ? &co__fds[fd].writer : &co__fds[fd].reader;
+			if(*waiter == NULL)
+			{
+				*waiter = this;
+				return true;
+			}
+		}
+		if(owns_fd)
+		{
+			co__unregister(r, fd);
+			close(fd);
+		}
+		result = wait_err;
+		return false;
+	}
+};
+
+/* Retries the reader or writer of [fd]. Skipped if an earlier resumption unregistered [fd] (e.g. with async_close). */
+static void co__wake(struct reactor *r, int fd, int writer)
+{
+	struct co__io *io;
+	
+	if(!co__registered(r, fd)) return;
+	if(writer)
+	{
+		io = co__fds[fd].writer;
+		co__fds[fd].writer = NULL;
+	}
+	else
+	{
+		io = co__fds[fd].reader;
+		co__fds[fd].reader = NULL;
+	}
+	// Attempts may move on to another file descriptor (see co__attempt_connect), wait() uses io->fd
+	if(io != NULL && (io->attempt(io) || !io->wait())) io->h.resume();
+}
+
+static void co__on_event(struct reactor *r, int fd, unsigned int events, void *arg)
+{
+	(void)arg;
+	if(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) co__wake(r, fd, 0);
+	if(events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) co__wake(r, fd, 1);
+}
+
+static int co__attempt_recv(struct co__io *io);
+static int co__attempt_send(struct co__io *io);
+static int co__attempt_connect(struct co__io *io);
+static int co__attempt_accept(struct co__io *io);
+
+struct co_recv : co__io
+{
+	char *bytes;
+	int bytes_size;
+};
+
+struct co_send : co__io
+{
+	const char *bytes;
+	int bytes_size;
+	int bytes_done;
+};
+
+struct co_connect : co__io
+{
+	struct tconnect_op op;
+};
+
+struct co_accept : co__io
+{
+	struct tlistener *l;
+	struct sockaddr_storage *addr;
+};
+
+
+#define ASYNC_RECV_ERRS (2)
+#define ASYNC_RECV_ERR_WAIT (-1)
+#define ASYNC_RECV_ERR_WAIT_STR "Unable to wait for file descriptor"
+#define ASYNC_RECV_ERR_RECV (-2)
+#define ASYNC_RECV_ERR_RECV_STR "Unable to receive data"
+
+#define ASYNC_RECV_ERR__STR(err) ((err == ASYNC_RECV_ERR_WAIT) ? ASYNC_RECV_ERR_WAIT_STR : (err == ASYNC_RECV_ERR_RECV) ? ASYNC_RECV_ERR_RECV_STR : "")
+
+/**
+ * Awaitable receive. co_await yields once some data arrived.
+ * 
+ * struct reactor *r: Reactor driving the coroutine
+ * int fd:            UNIX file descriptor to receive from
+ * char *bytes:       Buffer for the received data
+ * int bytes_size:    Size of [bytes]
+ * 
+ * return:            co_await yields the number of received bytes, 0 if the peer disconnected and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to wait for file descriptor => -1
+ *  Unable to receive data =>             -2
+ */
+co_recv async_recv(struct reactor *r, int fd, char *bytes, int bytes_size)
+{
+	co_recv op;
+	
+	op.r = r;
+	op.fd = fd;
+	op.events = EPOLLIN;
+	op.result = 0;
+	op.wait_err = -1;
+	op.owns_fd = 0;
+	op.attempt = co__attempt_recv;
+	op.bytes = bytes;
+	op.bytes_size = bytes_size;
+	return op;
+}
+
+static int co__attempt_recv(struct co__io *io)
+{
+	struct co_recv *op = static_cast<struct co_recv*>(io);
+	ssize_t ret;
+	
+	while((ret = recv(op->fd, op->bytes, op->bytes_size, MSG_DONTWAIT)) == -1 && errno == EINTR);
+	if(ret == -1)
+	{
+		if(errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+		op->result = -2;
+		return 1;
+	}
+	op->result = (int)ret;
+	return 1;
+}
+
+
+#define ASYNC_SEND_ERRS (2)
+#define ASYNC_SEND_ERR_WAIT (-1)
+#define ASYNC_SEND_ERR_WAIT_STR "Unable to wait for file descriptor"
+#define ASYNC_SEND_ERR_SEND (-2)
+#define ASYNC_SEND_ERR_SEND_STR "Unable to send data"
+
+#define ASYNC_SEND_ERR__STR(err) ((err == ASYNC_SEND_ERR_WAIT) ? ASYNC_SEND_ERR_WAIT_STR : (err == ASYNC_SEND_ERR_SEND) ? ASYNC_SEND_ERR_SEND_STR : "")
+
+/**
+ * Awaitable send. co_await yields once all bytes were handed to the kernel.
+ * 
+ * struct reactor *r: Reactor driving the coroutine
+ * int fd:            UNIX file descriptor to send over
+ * const char *bytes: Data to send
+ * int bytes_size:    Number of bytes to send
+ * 
+ * return:            co_await yields [bytes_size] upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to wait for file descriptor => -1
+ *  Unable to send data =>                -2
+ */
+co_send async_send(struct reactor *r, int fd, const char *bytes, int bytes_size)
+{
+	co_send op;
+	
+	op.r = r;
+	op.fd = fd;
+	op.events = EPOLLOUT;
+	op.result = 0;
+	op.wait_err = -1;
+	op.owns_fd = 0;
+	op.attempt = co__attempt_send;
+	op.bytes = bytes;
+	op.bytes_size = bytes_size;
+	op.bytes_done = 0;
+	return op;
+}
+
+static int co__attempt_send(struct co__io *io)
+{
+	struct co_send *op = static_cast<struct co_send*>(io);
+	ssize_t ret;
+	
+	while(op->bytes_done < op->bytes_size)
+	{
+		if((ret = send(op->fd, op->bytes + op->bytes_done, op->bytes_size - op->bytes_done, MSG_DONTWAIT | MSG_NOSIGNAL)) == -1)
+		{
+			if(errno == EINTR) continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+			op->result = -2;
+			return 1;
+		}
+		op->bytes_done += (int)ret;
+	}
+	op->result = op->bytes_done;
+	return 1;
+}
+
+
+#define ASYNC_CONNECT_ERRS (4)
+#define ASYNC_CONNECT_ERR_ADDR (-1)
+#define ASYNC_CONNECT_ERR_ADDR_STR "Unable to resolve address"
+#define ASYNC_CONNECT_ERR_SOCK (-2)
+#define ASYNC_CONNECT_ERR_SOCK_STR "Unable to set up socket"
+#define ASYNC_CONNECT_ERR_CONN (-3)
+#define ASYNC_CONNECT_ERR_CONN_STR "Unable to connect to server"
+#define ASYNC_CONNECT_ERR_WAIT (-4)
+#define ASYNC_CONNECT_ERR_WAIT_STR "Unable to wait for file descriptor"
+
+#define ASYNC_CONNECT_ERR__STR(err) ((err == ASYNC_CONNECT_ERR_ADDR) ? ASYNC_CONNECT_ERR_ADDR_STR : (err == ASYNC_CONNECT_ERR_SOCK) ? ASYNC_CONNECT_ERR_SOCK_STR : (err == ASYNC_CONNECT_ERR_CONN) ? ASYNC_CONNECT_ERR_CONN_STR : (err == ASYNC_CONNECT_ERR_WAIT) ? ASYNC_CONNECT_ERR_WAIT_STR : "")
+
+/**
+ * Awaitable connect. Name resolution goes through the DNS cache and blocks on a miss (see tconnect_async).
+ * Falls back on the other resolved addresses one after another, like tconnect.
+ * 
+ * struct reactor *r:       Reactor driving the coroutine
+ * const char* target:      IP or web address of the server (e.g. "192.168.0.1", "www.example.com")
+ * const char* target_port: Port of the server (e.g. "80", "1729")
+ * 
+ * return:                  co_await yields the connected non-blocking UNIX file descriptor and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to resolve address =>          -1
+ *  Unable to set up socket =>            -2
+ *  Unable to connect to server =>        -3
+ *  Unable to wait for file descriptor => -4
+ */
+co_connect async_connect(struct reactor *r, const char* target, const char* target_port)
+{
+	co_connect op;
+	
+	op.r = r;
+	op.fd = tconnect_async(target, target_port, &op.op);
+	op.events = EPOLLOUT;
+	op.result = op.fd;
+	op.wait_err = -4;
+	op.owns_fd = 1;
+	op.attempt = co__attempt_connect;
+	return op;
+}
+
+static int co__attempt_connect(struct co__io *io)
+{
+	struct co_connect *op = static_cast<struct co_connect*>(io);
+	int ret;
+	
+	while((ret = tconnect_finish(op->fd)) == -1)
+	{
+		// The next address gets a new file descriptor, registered once the awaitable waits again
+		co__unregister(op->r, op->fd);
+		if((op->fd = tconnect_next(&op->op)) < 0)
+		{
+			op->result = -3;
+			return 1;
+		}
+	}
+	if(ret == -2) return 0;
+	op->result = op->fd;
+	return 1;
+}
+
+
+#define ASYNC_ACCEPT_ERRS (2)
+#define ASYNC_ACCEPT_ERR_WAIT (-1)
+#define ASYNC_ACCEPT_ERR_WAIT_STR "Unable to wait for file descriptor"
+#define ASYNC_ACCEPT_ERR_ACCEPT (-2)
+#define ASYNC_ACCEPT_ERR_ACCEPT_STR "Unable to accept incoming connection"
+
+#define ASYNC_ACCEPT_ERR__STR(err) ((err == ASYNC_ACCEPT_ERR_WAIT) ? ASYNC_ACCEPT_ERR_WAIT_STR : (err == ASYNC_ACCEPT_ERR_ACCEPT) ? ASYNC_ACCEPT_ERR_ACCEPT_STR : "")
+
+/**
+ * Awaitable accept. Only one coroutine may wait on a listener at a time.
+ * 
+ * struct reactor *r:             Reactor driving the coroutine
+ * struct tlistener *l:           Listener set up with tlistener_create
+ * struct sockaddr_storage *addr: Pointer in which the address of the connecting node will be saved (may be NULL)
+ * 
+ * return:                        co_await yields the accepted non-blocking UNIX file descriptor and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to wait for file descriptor =>   -1
+ *  Unable to accept incoming connection => -2
+ */
+co_accept async_accept(struct reactor *r, struct tlistener *l, struct sockaddr_storage *addr)
+{
+	co_accept op;
+	
+	op.r = r;
+	op.fd = l->fd;
+	op.events = EPOLLIN;
+	op.result = 0;
+	op.wait_err = -1;
+	op.owns_fd = 0;
+	op.attempt = co__attempt_accept;
+	op.l = l;
+	op.addr = addr;
+	return op;
+}
+
+static int co__attempt_accept(struct co__io *io)
+{
+	struct co_accept *op = static_cast<struct co_accept*>(io);
+	int fd;
+	int ret = tlistener_accept_batch(op->l, &fd, op->addr, 1);
+	
+	if(ret == 0) return 0;
+	op->result = (ret == 1) ? fd : -2;
+	return 1;
+}
+
+
+#define ASYNC_CLOSE_ERRS (1)
+#define ASYNC_CLOSE_ERR_CLOSE (-1)
+#define ASYNC_CLOSE_ERR_CLOSE_STR "Unable to close file descriptor"
+
+#define ASYNC_CLOSE_ERR__STR(err) ((err == ASYNC_CLOSE_ERR_CLOSE) ? ASYNC_CLOSE_ERR_CLOSE_STR : "")
+
+/**
+ * Unregisters a file descriptor used by awaitables from the reactor and closes it. Not awaitable.
+ * Coroutines still waiting on it are resumed with their "Unable to wait for file descriptor" error code.
+ * 
+ * struct reactor *r: Reactor driving the coroutines
+ * int fd:            UNIX file descriptor to close
+ * 
+ * return:            Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to close file descriptor => -1
+ */
+int async_close(struct reactor *r, int fd)
+{
+	struct co__io *reader = NULL, *writer = NULL;
+	int ret;
+	
+	if(co__registered(r, fd))
+	{
+		reader = co__fds[fd].reader;
+		writer = co__fds[fd].writer;
+		co__unregister(r, fd);
+	}
+	ret = close(fd);
+	if(reader != NULL)
+	{
+		reader->result = reader->wait_err;
+		reader->h.resume();
+	}
+	if(writer != NULL)
+	{
+		writer->result = writer->wait_err;
+		writer->h.resume();
+	}
+	return (ret == -1) ? -1 : 0;
+}
+#endif /* __cplusplus >= 202002L */
+
+/*
+io_uring engine (compile with -DNETLIB_IO_URING, needs Linux 6.0 or newer):
+	Completion based counterparts of tsend, trecv, usend and tlisten_accept.
+	Requests are only queued by the uring_* functions and handed to the kernel by uring_submit or
+	uring_run_once, so a whole batch of requests costs a single io_uring_enter() syscall.
+	Accepts and receives can be armed multishot: one request keeps producing completions (new connections,
+	received data from a registered buffer ring) until it fails or is cancelled by the kernel.
+	
+	Every request is described by a caller owned struct uring_op which must stay valid while op->armed is set.
+	Callbacks receive the same values as the blocking counterparts: bytes / file descriptors upon success and
+	the counterparts' error codes (TSEND_ERR_SEND, TRECV_ERR_NODATA, USEND_ERR_SEND, TLISTEN_ACCEPT_ERR_ACCEPT) upon failure.
+	struct uring counts io_uring_enter() calls and completions in stat_enter / stat_completions.
+*/
+#ifdef NETLIB_IO_URING
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#define URING_OP_TSEND (1)
+#define URING_OP_TRECV (2)
+#define URING_OP_TRECV_MULTI (3)
+#define URING_OP_ACCEPT_MULTI (4)
+#define URING_OP_USEND (5)
+
+#define URING_BGID (0)
+
+#ifndef IORING_SQ_CQ_OVERFLOW
+#define IORING_SQ_CQ_OVERFLOW (1U << 1)
+#endif
+
+struct uring;
+struct uring_op;
+
+/* [buf] is only set for multishot receives. It points into the buffer ring and is recycled once the callback returns. */
+typedef void (*uring_cb)(struct uring *u, struct uring_op *op, int res, char *buf);
+
+struct uring_op
+{
+	uring_cb cb;
+	void *arg;
+	int type;
+	int fd;
+	int armed;
+	char *bytes;
+	int bytes_size;
+	int bytes_done;
+	struct iovec iov;
+	struct msghdr msg;
+};
+
+struct uring
+{
+	int ring_fd;
+	unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array, *sq_flags;
+	unsigned int sq_entries, sq_local_tail, sq_pending;
+	struct io_uring_sqe *sqes;
+	unsigned int *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe *cqes;
+	void *sq_ptr, *cq_ptr;
+	size_t sq_ptr_size, cq_ptr_size, sqes_size;
+	struct io_uring_buf_ring *br;
+	size_t br_ring_size;
+	char *br_bufs;
+	unsigned int br_entries, br_buf_size;
+	unsigned long stat_enter;
+	unsigned long stat_completions;
+};
+
+
+#define URING_CREATE_ERRS (2)
+#define URING_CREATE_ERR_SETUP (-1)
+#define URING_CREATE_ERR_SETUP_STR "Unable to set up io_uring instance"
+#define URING_CREATE_ERR_MMAP (-2)
+#define URING_CREATE_ERR_MMAP_STR "Unable to map io_uring rings"
+
+#define URING_CREATE_ERR__STR(err) ((err == URING_CREATE_ERR_SETUP) ? URING_CREATE_ERR_SETUP_STR : (err == URING_CREATE_ERR_MMAP) ? URING_CREATE_ERR_MMAP_STR : "")
+
+/**
+ * Sets up an io_uring instance.
+ * 
+ * struct uring *u:       Pointer to the ring to initialize
+ * unsigned int entries:  Size of the submission queue (rounded up to a power of 2 by the kernel)
+ * 
+ * return:                Returns 0 upon success and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to set up io_uring instance => -1
+ *  Unable to map io_uring rings =>       -2
+ */
+int uring_create(struct uring *u, unsigned int entries)
+{
+	struct io_uring_params p;
+	
+	memset(u, 0, sizeof *u);
+	memset(&p, 0, sizeof p);
+	
+	if((u->ring_fd = (int)syscall(__NR_io_uring_setup, entries, &p)) < 0)
+	{
+		return -1;
+	}
+	
+	u->sq_ptr_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	u->cq_ptr_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if(p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if(u->cq_ptr_size > u->sq_ptr_size) u->sq_ptr_size = u->cq_ptr_size;
+		u->cq_ptr_size = u->sq_ptr_size;
+	}
+	
+	u->sq_ptr = mmap(NULL, u->sq_ptr_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQ_RING);
+	if(u->sq_ptr == MAP_FAILED)
+	{
+		close(u->ring_fd);
+		return -2;
+	}
+	if(p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		u->cq_ptr = u->sq_ptr;
+	}
+	else
+	{
+		u->cq_ptr = mmap(NULL, u->cq_ptr_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_CQ_RING);
+		if(u->cq_ptr == MAP_FAILED)
+		{
+			munmap(u->sq_ptr, u->sq_ptr_size);
+			close(u->ring_fd);
+			return -2;
+		}
+	}
+	u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	u->sqes = (struct io_uring_sqe*)mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQES);
+	if(u->sqes == MAP_FAILED)
+	{
+		if(u->cq_ptr != u->sq_ptr) munmap(u->cq_ptr, u->cq_ptr_size);
+		munmap(u->sq_ptr, u->sq_ptr_size);
+		close(u->ring_fd);
+		return -2;
+	}
+	
+	u->sq_head = (unsigned int*)((char*)u->sq_ptr + p.sq_off.head);
+	u->sq_tail = (unsigned int*)((char*)u->sq_ptr + p.sq_off.tail);
+	u->sq_mask = (unsigned int*)((char*)u->sq_ptr + p.sq_off.ring_mask);
+	u->sq_array = (unsigned int*)((char*)u->sq_ptr + p.sq_off.array);
+	u->sq_flags = (unsigned int*)((char*)u->sq_ptr + p.sq_off.flags);
+	u->sq_entries = p.sq_entries;
+	u->sq_local_tail = *u->sq_tail;
+	u->cq_head = (unsigned int*)((char*)u->cq_ptr + p.cq_off.head);
+	u->cq_tail = (unsigned int*)((char*)u->cq_ptr + p.cq_off.tail);
+	u->cq_mask = (unsigned int*)((char*)u->cq_ptr + p.cq_off.ring_mask);
+	u->cqes = (struct io_uring_cqe*)((char*)u->cq_ptr + p.cq_off.cqes);
+	return 0;
+}
+
+
+#define URING_PROVIDE_BUFFERS_ERRS (3)
+#define URING_PROVIDE_BUFFERS_ERR_MEM (-1)
+#define URING_PROVIDE_BUFFERS_ERR_MEM_STR "Unable to allocate buffer ring"
+#define URING_PROVIDE_BUFFERS_ERR_REGISTER (-2)
+#define URING_PROVIDE_BUFFERS_ERR_REGISTER_STR "Unable to register buffer ring"
+#define URING_PROVIDE_BUFFERS_ERR_ARG (-3)
+#define URING_PROVIDE_BUFFERS_ERR_ARG_STR "Invalid buffer ring parameters"
+
+#define URING_PROVIDE_BUFFERS_ERR__STR(err) ((err == URING_PROVIDE_BUFFERS_ERR_MEM) ? URING_PROVIDE_BUFFERS_ERR_MEM_STR : (err == URING_PROVIDE_BUFFERS_ERR_REGISTER) ? URING_PROVIDE_BUFFERS_ERR_REGISTER_STR : (err == URING_PROVIDE_BUFFERS_ERR_ARG) ? URING_PROVIDE_BUFFERS_ERR_ARG_STR : "")
 
 /**
- * Creates a TCP host on port [PORT] and returns UNIX file descriptor.
+ * Registers a ring of receive buffers with the kernel. Required before arming multishot receives.
  * 
- * const char* PORT: The port on which to listen for incoming connections (as a C string [a.k.a. char pointer])
+ * struct uring *u:      Ring to register the buffers with
+ * unsigned int entries: Number of buffers (must be a power of 2, at most 32768)
+ * unsigned int size:    Size of every single buffer in bytes
  * 
- * return:           Returns UNIX file descriptor on which one can listen for & accept incomming connections. Returns error code upon failure (error codes below)
+ * return:               Returns 0 upon success and error code upon failure
  * 
  * {error codes}:
- *  Unable to resolve address =>                           -1
- *  Unable to set up UNIX files descriptor =>              -2
- *  Unable to bind to port =>                              -3
- *  Unable to force bind to port (Enable reuse of port) => -4
+ *  Unable to allocate buffer ring => -1
+ *  Unable to register buffer ring => -2
+ *  Invalid buffer ring parameters => -3
  */
-int tcreate_host(const char* PORT)
+int uring_provide_buffers(struct uring *u, unsigned int entries, unsigned int size)
 {
-	int retfd;
-	struct addrinfo hints, *servinfo;
+	struct io_uring_buf_reg reg;
+	unsigned int i;
 	
-	memset(&hints, 0, sizeof hints);
-	hints.ai_family = AF_UNSPEC;
-	hints.ai_socktype = SOCK_STREAM;
-	hints.ai_flags = AI_PASSIVE;
-	
-	if(getaddrinfo(NULL, PORT, &hints, &servinfo) != 0)
+	// Recycling masks the tail with [entries] - 1
+	if(entries == 0 || entries > 32768 || (entries & (entries - 1)) != 0 || size == 0)
+	{
+		return -3;
+	}
+	u->br_ring_size = entries * sizeof(struct io_uring_buf);
+	u->br = (struct io_uring_buf_ring*)mmap(NULL, u->br_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(u->br == MAP_FAILED)
 	{
+		u->br = NULL;
 		return -1;
 	}
-	
-	if((retfd = socket(servinfo->ai_family, servinfo->ai_socktype, servinfo->ai_protocol)) == -1)
+	if((u->br_bufs = (char*)malloc((size_t)entries * size)) == NULL)
 	{
-		return -2;
+		munmap(u->br, u->br_ring_size);
+		u->br = NULL;
+		return -1;
 	}
 	
-	int yes = 1;
-	if (setsockopt(retfd,SOL_SOCKET,SO_REUSEADDR,&yes,sizeof(int)) == -1) {
-		return -4;
+	memset(&reg, 0, sizeof reg);
+	reg.ring_addr = (uint64_t)(uintptr_t)u->br;
+	reg.ring_entries = entries;
+	reg.bgid = URING_BGID;
+	if(syscall(__NR_io_uring_register, u->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+	{
+		free(u->br_bufs);
+		munmap(u->br, u->br_ring_size);
+		u->br = NULL;
+		return -2;
 	}
 	
-	if(bind(retfd, servinfo->ai_addr, servinfo->ai_addrlen) == -1)
+	u->br_entries = entries;
+	u->br_buf_size = size;
+	for(i = 0; i < entries; i++)
 	{
-		return -3;
+		u->br->bufs[i].addr = (uint64_t)(uintptr_t)(u->br_bufs + (size_t)i * size);
+		u->br->bufs[i].len = size;
+		u->br->bufs[i].bid = (unsigned short)i;
 	}
+	__atomic_store_n(&u->br->tail, (unsigned short)entries, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static void uring__recycle_buffer(struct uring *u, unsigned short bid)
+{
+	unsigned short tail = u->br->tail;
+	struct io_uring_buf *b = &u->br->bufs[tail & (u->br_entries - 1)];
 	
-	freeaddrinfo(servinfo);
+	b->addr = (uint64_t)(uintptr_t)(u->br_bufs + (size_t)bid * u->br_buf_size);
+	b->len = u->br_buf_size;
+	b->bid = bid;
+	__atomic_store_n(&u->br->tail, (unsigned short)(tail + 1), __ATOMIC_RELEASE);
+}
+
+static int uring__enter(struct uring *u, unsigned int to_submit, unsigned int min_complete, unsigned int flags)
+{
+	int ret;
 	
-	return retfd;
+	do
+	{
+		u->stat_enter++;
+		ret = (int)syscall(__NR_io_uring_enter, u->ring_fd, to_submit, min_complete, flags, NULL, 0);
+	}while(ret < 0 && errno == EINTR);
+	return ret;
 }
 
 
-#define TLISTEN_ACCEPT_ERRS (2)
-#define TLISTEN_ACCEPT_ERR_LISTEN (-1)
-#define TLISTEN_ACCEPT_ERR_LISTEN_STR "Unable to listen for incoming connection"
-#define TLISTEN_ACCEPT_ERR_ACCEPT (-2)
-#define TLISTEN_ACCEPT_ERR_ACCEPT_STR "Unable to accept incoming connection"
+#define URING_SUBMIT_ERRS (1)
+#define URING_SUBMIT_ERR_ENTER (-1)
+#define URING_SUBMIT_ERR_ENTER_STR "Unable to submit requests"
 
-#define TLISTEN_ACCEPT_ERR__STR(err) ((err == TLISTEN_ACCEPT_ERR_LISTEN) ? TLISTEN_ACCEPT_ERR_LISTEN_STR : (err == TLISTEN_ACCEPT_ERR_ACCEPT) ? TLISTEN_ACCEPT_ERR_ACCEPT_STR : "")
+#define URING_SUBMIT_ERR__STR(err) ((err == URING_SUBMIT_ERR_ENTER) ? URING_SUBMIT_ERR_ENTER_STR : "")
 
 /**
- * Listens on given UNIX file descriptor form incomming connections accepts the first it gets. Returns file descriptor.
- * This function will block until either an error occured or a connection was successfully established!
+ * Hands all queued requests to the kernel with a single syscall.
  * 
- * int sockfd:        UNIX file descriptor on which the Kernel is listening for incoming connections
- * const int BACKLOG: The amount of connections the queue will hold. Should be equal to or less than real backlog, which is defined by the kernel (e.g. 128 for linux kernel version 2.x)
+ * struct uring *u: Ring to submit
  * 
- * return:           Returns UNIX file descriptor over which one can communicate with connecting node. Returns error code upon failure (error codes below)
+ * return:          Returns number of requests submitted and error code upon failure
  * 
  * {error codes}:
- *  Unable to listen for incoming connection =>  -1
- *  Unable to accept incoming connection =>      -2
+ *  Unable to submit requests => -1
  */
-int tlisten_accept(int sockfd, const int BACKLOG)
+int uring_submit(struct uring *u)
 {
-	int retfd;
-	struct sockaddr_storage conn_addr;
-	socklen_t conn_addr_size = sizeof conn_addr;
+	int ret;
 	
-	if(listen(sockfd, BACKLOG) == -1)
+	if(u->sq_pending == 0) return 0;
+	__atomic_store_n(u->sq_tail, u->sq_local_tail, __ATOMIC_RELEASE);
+	if((ret = uring__enter(u, u->sq_pending, 0, 0)) < 0)
 	{
 		return -1;
 	}
+	u->sq_pending -= ret;
+	return ret;
+}
+
+static struct io_uring_sqe *uring__get_sqe(struct uring *u, struct uring_op *op, int type, int fd)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int idx;
 	
-	if((retfd = accept(sockfd, (struct sockaddr*)&conn_addr, &conn_addr_size)) == -1)
+	if(u->sq_local_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entries)
 	{
-		return -2;
+		// Submission queue is full, flush it to make room
+		if(uring_submit(u) < 0 || u->sq_local_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entries)
+		{
+			return NULL;
+		}
 	}
+	idx = u->sq_local_tail & *u->sq_mask;
+	sqe = &u->sqes[idx];
+	memset(sqe, 0, sizeof *sqe);
+	sqe->fd = fd;
+	sqe->user_data = (uint64_t)(uintptr_t)op;
+	u->sq_array[idx] = idx;
+	u->sq_local_tail++;
+	u->sq_pending++;
 	
-	return retfd;
+	op->type = type;
+	op->fd = fd;
+	op->armed = 1;
+	return sqe;
+}
+
+static int uring__queue_send(struct uring *u, struct uring_op *op)
+{
+	struct io_uring_sqe *sqe;
+	
+	if((sqe = uring__get_sqe(u, op, URING_OP_TSEND, op->fd)) == NULL)
+	{
+		return -1;
+	}
+	sqe->opcode = IORING_OP_SEND;
+	sqe->addr = (uint64_t)(uintptr_t)(op->bytes + op->bytes_done);
+	sqe->len = op->bytes_size - op->bytes_done;
+	return 0;
 }
 
 
+#define URING_TSEND_ERRS (1)
+#define URING_TSEND_ERR_FULL (-1)
+#define URING_TSEND_ERR_FULL_STR "Unable to queue request"
+
+#define URING_TSEND_ERR__STR(err) ((err == URING_TSEND_ERR_FULL) ? URING_TSEND_ERR_FULL_STR : "")
+
 /**
- * Listens on given UNIX file descriptor form incomming connections accepts the first it gets. Returns file descriptor.
- * This function will block until either an error occured or a connection was successfully established!
+ * Queues sending data via TCP. Short writes are resubmitted until all bytes are sent.
+ * The callback receives the number of bytes sent or TSEND_ERR_SEND.
  * 
- * int sockfd:                    UNIX file descriptor on which the Kernel is listening for incoming connections
- * const int BACKLOG:             The amount of connections the queue will hold. Should be equal to or less than real backlog, which is defined by the kernel (e.g. 128 for linux kernel version 2.x)
- * struct sockaddr_storage &addr: Reference to struct in which information about connecting node will be saved
- * socklen_t &addr_size:          Size of [addr]
+ * struct uring *u:     Ring to queue on
+ * struct uring_op *op: Request (with cb and arg set by the caller)
+ * int targetfd:        UNIX file descriptor of target (With TCP connection established)
+ * char* bytes:         Pointer to the bytes which will be sent. Must stay valid until the callback ran.
+ * int bytes_size:      Number of bytes to send
  * 
- * return:                        Returns UNIX file descriptor over which one can communicate with connecting node. Returns error code upon failure (error codes below)
+ * return:              Returns 0 upon success and error code upon failure
  * 
  * {error codes}:
- *  Unable to listen for incoming connection =>  -1
- *  Unable to accept incoming connection =>      -2
+ *  Unable to queue request => -1
  */
-int tlisten_accept_a(int sockfd, const int BACKLOG, struct sockaddr_storage *addr, socklen_t *addr_size)
+int uring_tsend(struct uring *u, struct uring_op *op, int targetfd, char* bytes, int bytes_size)
 {
-	int retfd;
-	
-	if(listen(sockfd, BACKLOG) == -1)
-	{
-		return -1;
-	}
-	
-	if((retfd = accept(sockfd, (struct sockaddr*)addr, addr_size)) == -1)
-	{
-		return -2;
-	}
-	
-	return retfd;
+	op->fd = targetfd;
+	op->bytes = bytes;
+	op->bytes_size = bytes_size;
+	op->bytes_done = 0;
+	return uring__queue_send(u, op);
 }
 
-#define USOCK_ERRS (2)
-#define USOCK_ERR_ADDR (-1)
-#define USOCK_ERR_ADDR_STR "Unable to resolve address"
-#define USOCK_ERR_SOCK (-2)
-#define USOCK_ERR_SOCK_STR "Unable to set up socket"
 
-#define USOCK_ERR__STR(err) ((err == USOCK_ERR_ADDR) ? USOCK_ERR_ADDR_STR : (err == USOCK_ERR_SOCK) ? USOCK_ERR_SOCK_STR : "")
+#define URING_TRECV_ERRS (1)
+#define URING_TRECV_ERR_FULL (-1)
+#define URING_TRECV_ERR_FULL_STR "Unable to queue request"
+
+#define URING_TRECV_ERR__STR(err) ((err == URING_TRECV_ERR_FULL) ? URING_TRECV_ERR_FULL_STR : "")
 
 /**
- * Resolve target address and return UNIX file descriptor.
+ * Queues a single receive via TCP into a caller supplied buffer.
+ * The callback receives the number of bytes received or TRECV_ERR_NODATA.
  * 
- * const char* target:          IP or web address of host to send to (e.g. "192.168.0.1", "www.example.com")
- * const char* target_port:     Port to send to at target (e.g. "80", "1729")
- * struct addrinfo *targetinfo: Pointer to addrinfo structure in which infos about the target will be saved (required for usend)
+ * struct uring *u:     Ring to queue on
+ * struct uring_op *op: Request (with cb and arg set by the caller)
+ * int targetfd:        UNIX file descriptor of target (With TCP connection established)
+ * char* bytes:         Pointer to the bytes where the received data will be written
+ * int bytes_size:      Number of bytes allocated at [bytes]
  * 
- * return:                      Returns UNIX file descriptor to socket over which one can send UDP packages. Returns error code upon failure (error codes below)
+ * return:              Returns 0 upon success and error code upon failure
  * 
  * {error codes}:
- *  Unable to resolve address => -1
- *  Unable to set up socket =>   -2
+ *  Unable to queue request => -1
  */
-int usock(const char* target, const char* target_port, struct addrinfo **targetinfo)
+int uring_trecv(struct uring *u, struct uring_op *op, int targetfd, char* bytes, int bytes_size)
 {
-	struct addrinfo hints;
-	int retfd;
-	
-	memset(&hints, 0, sizeof hints);
-	
-	hints.ai_family = AF_UNSPEC;
-	hints.ai_socktype = SOCK_DGRAM;
+	struct io_uring_sqe *sqe;
 	
-	if(getaddrinfo(target, target_port, &hints, targetinfo) != 0)
+	if((sqe = uring__get_sqe(u, op, URING_OP_TRECV, targetfd)) == NULL)
 	{
 		return -1;
 	}
-	
-	if((retfd = socket((*targetinfo)->ai_family, (*targetinfo)->ai_socktype, (*targetinfo)->ai_protocol)) == -1)
-	{
-		return -2;
-	}
-	return retfd;
+	op->bytes = bytes;
+	op->bytes_size = bytes_size;
+	sqe->opcode = IORING_OP_RECV;
+	sqe->addr = (uint64_t)(uintptr_t)bytes;
+	sqe->len = bytes_size;
+	return 0;
 }
 
 
-#define USEND_ERRS (1)
-#define USEND_ERR_SEND (-1)
-#define USEND_ERR_SEND_STR "Unable to send data"
+#define URING_TRECV_MULTISHOT_ERRS (2)
+#define URING_TRECV_MULTISHOT_ERR_NOBUF (-1)
+#define URING_TRECV_MULTISHOT_ERR_NOBUF_STR "No buffer ring registered"
+#define URING_TRECV_MULTISHOT_ERR_FULL (-2)
+#define URING_TRECV_MULTISHOT_ERR_FULL_STR "Unable to queue request"
 
-#define USEND_ERR__STR(err) ((err == USEND_ERR_SEND) ? USEND_ERR_SEND_STR : "")
+#define URING_TRECV_MULTISHOT_ERR__STR(err) ((err == URING_TRECV_MULTISHOT_ERR_NOBUF) ? URING_TRECV_MULTISHOT_ERR_NOBUF_STR : (err == URING_TRECV_MULTISHOT_ERR_FULL) ? URING_TRECV_MULTISHOT_ERR_FULL_STR : "")
 
 /**
- * Send data via UDP.
+ * Arms a multishot receive via TCP, which picks its buffers from the registered buffer ring (see uring_provide_buffers).
+ * The callback is invoked for every chunk received with the number of bytes and a pointer to the data,
+ * or with TRECV_ERR_NODATA once the target disconnected or the buffer ring ran dry. Once op->armed is 0,
+ * the request is finished and may be armed again.
  * 
- * int sockfd:                  Socket over which packets will be send
- * struct addrinfo *targetinfo: Pointer to addrinfo structure in which infos about the target will be saved (required for usend)
- * const char* data             Pointer to data which will be send
- * const int DATA_SIZE          Size of [data] memory block
+ * struct uring *u:     Ring to queue on
+ * struct uring_op *op: Request (with cb and arg set by the caller)
+ * int targetfd:        UNIX file descriptor of target (With TCP connection established)
+ * 
+ * return:              Returns 0 upon success and error code upon failure
  * 
- * return:                      Returns bytes sent (might not be equal to DATA_SIZE)
- *
  * {error codes}:
- *  Unable to send data =>       -1
+ *  No buffer ring registered => -1
+ *  Unable to queue request =>   -2
  */
-int usend(int sockfd, struct addrinfo *targetinfo, const char* data, const int DATA_SIZE)
+int uring_trecv_multishot(struct uring *u, struct uring_op *op, int targetfd)
 {
-	return sendto(sockfd, data, DATA_SIZE, 0, targetinfo->ai_addr, targetinfo->ai_addrlen);
+	struct io_uring_sqe *sqe;
+	
+	if(u->br == NULL)
+	{
+		return -1;
+	}
+	if((sqe = uring__get_sqe(u, op, URING_OP_TRECV_MULTI, targetfd)) == NULL)
+	{
+		return -2;
+	}
+	sqe->opcode = IORING_OP_RECV;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_BGID;
+	return 0;
 }
 
 
-#define USEND_ONCE_ERRS (3)
-#define USEND_ONCE_ERR_ADDR (-1)
-#define USEND_ONCE_ERR_ADDR_STR "Unable to resolve address"
-#define USEND_ONCE_ERR_SOCK (-2)
-#define USEND_ONCE_ERR_SOCK_STR "Unable to set up socket"
-#define USEND_ONCE_ERR_SEND (-3)
-#define USEND_ONCE_ERR_SEND_STR "Unable to send data"
+#define URING_TLISTEN_ACCEPT_ERRS (2)
+#define URING_TLISTEN_ACCEPT_ERR_LISTEN (-1)
+#define URING_TLISTEN_ACCEPT_ERR_LISTEN_STR "Unable to listen for incoming connection"
+#define URING_TLISTEN_ACCEPT_ERR_FULL (-2)
+#define URING_TLISTEN_ACCEPT_ERR_FULL_STR "Unable to queue request"
 
-#define USEND_ONCE_ERR__STR(err) ((err == USEND_ONCE_ERR_ADDR) ? USEND_ONCE_ERR_ADDR_STR : (err == USEND_ONCE_ERR_SOCK) ? USEND_ONCE_ERR_SOCK_STR : (err == USEND_ONCE_ERR_SEND) ? USEND_ONCE_ERR_SEND_STR : "")
+#define URING_TLISTEN_ACCEPT_ERR__STR(err) ((err == URING_TLISTEN_ACCEPT_ERR_LISTEN) ? URING_TLISTEN_ACCEPT_ERR_LISTEN_STR : (err == URING_TLISTEN_ACCEPT_ERR_FULL) ? URING_TLISTEN_ACCEPT_ERR_FULL_STR : "")
 
 /**
- * Send UDP packet to target host and return bytes sent.
+ * Starts listening on the given UNIX file descriptor and arms a multishot accept on it.
+ * The callback is invoked with the file descriptor of every accepted connection or TLISTEN_ACCEPT_ERR_ACCEPT.
  * 
- * const char* target:      IP or web address of host to send to (e.g. "192.168.0.1", "www.example.com")
- * const char* target_port: Port to send to at target (e.g. "80", "1729")
- * const char* data:        Pointer to data which will be send
- * const int DATA_SIZE:     Size of [data] memory block
+ * struct uring *u:     Ring to queue on
+ * struct uring_op *op: Request (with cb and arg set by the caller)
+ * int sockfd:          UNIX file descriptor returned by tcreate_host
+ * const int BACKLOG:   The amount of connections the queue will hold
  * 
- * return:                  Returns bytes sent (might not be equal to DATA_SIZE). Returns error code upon failure (error codes below)
+ * return:              Returns 0 upon success and error code upon failure
  * 
  * {error codes}:
- *  Unable to resolve address => -1
- *  Unable to set up socket =>   -2
- *  Unable to send data =>       -3
+ *  Unable to listen for incoming connection => -1
+ *  Unable to queue request =>                  -2
  */
-int usend_once(const char* target, const char* target_port, const char* data, const int DATA_SIZE)
+int uring_tlisten_accept(struct uring *u, struct uring_op *op, int sockfd, const int BACKLOG)
 {
-	struct addrinfo hints, *servinfo;
-	int sockfd;
-	int retbytes;
-	
-	memset(&hints, 0, sizeof hints);
-	
-	hints.ai_family = AF_UNSPEC;
-	hints.ai_socktype = SOCK_DGRAM;
+	struct io_uring_sqe *sqe;
 	
-	if(getaddrinfo(target, target_port, &hints, &servinfo) != 0)
+	if(listen(sockfd, BACKLOG) == -1)
 	{
 		return -1;
 	}
-	if((sockfd = socket(servinfo->ai_family, servinfo->ai_socktype, servinfo->ai_protocol)) == -1)
+	if((sqe = uring__get_sqe(u, op, URING_OP_ACCEPT_MULTI, sockfd)) == NULL)
 	{
-		freeaddrinfo(servinfo);
 		return -2;
 	}
-	if((retbytes = sendto(sockfd, data, DATA_SIZE, 0, servinfo->ai_addr, servinfo->ai_addrlen)) == -1)
-	{
-		freeaddrinfo(servinfo);
-		return -3;
-	}
-	freeaddrinfo(servinfo);
-	close(sockfd);
-	return retbytes;
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->accept_flags = SOCK_CLOEXEC;
+	return 0;
 }
 
 
-#define UCREATE_HOST_ERRS (4)
-#define UCREATE_HOST_ERR_ADDR (-1)
-#define UCREATE_HOST_ERR_ADDR_STR "Unable to resolve address"
-#define UCREATE_HOST_ERR_FD (-2)
-#define UCREATE_HOST_ERR_FD_STR "Unable to set up files descriptor"
-#define UCREATE_HOST_ERR_PORT (-3)
-#define UCREATE_HOST_ERR_PORT_STR "Unable to bind to port"
-#define UCREATE_HOST_ERR_FPORT (-4)
-#define UCREATE_HOST_ERR_FPORT_STR "Unable to force bind to port"
+#define URING_USEND_ERRS (1)
+#define URING_USEND_ERR_FULL (-1)
+#define URING_USEND_ERR_FULL_STR "Unable to queue request"
 
-#define UCREATE_HOST_ERR__STR(err) ((err == UCREATE_HOST_ERR_ADDR) ? UCREATE_HOST_ERR_ADDR : (err == UCREATE_HOST_ERR_FD) ? UCREATE_HOST_ERR_FD_STR :(err == UCREATE_HOST_ERR_PORT) ? UCREATE_HOST_ERR_PORT_STR : (err == UCREATE_HOST_ERR_FPORT) ? UCREATE_HOST_ERR_FPORT_STR : "")
+#define URING_USEND_ERR__STR(err) ((err == URING_USEND_ERR_FULL) ? URING_USEND_ERR_FULL_STR : "")
 
 /**
- * Creates a UDP host on port [PORT] and returns UNIX file descriptor.
+ * Queues sending a datagram via UDP. The callback receives the number of bytes sent or USEND_ERR_SEND.
  * 
- * const char* PORT: The port on which to listen for incoming connections (as a C string [a.k.a. char pointer])
+ * struct uring *u:             Ring to queue on
+ * struct uring_op *op:         Request (with cb and arg set by the caller)
+ * int sockfd:                  Socket over which packets will be send
+ * struct addrinfo *targetinfo: Target as returned by usock or usock_cached. Must stay valid until the callback ran.
+ * const char* data:            Pointer to data which will be send. Must stay valid until the callback ran.
+ * const int DATA_SIZE:         Size of [data] memory block
  * 
- * return:           Returns UNIX file descriptor on which one can listen for & accept incomming connections. Returns error code upon failure (error codes below)
+ * return:                      Returns 0 upon success and error code upon failure
  * 
  * {error codes}:
- *  Unable to resolve address =>                           -1
- *  Unable to set up UNIX files descriptor =>              -2
- *  Unable to bind to port =>                              -3
- *  Unable to force bind to port (Enable reuse of port) => -4
+ *  Unable to queue request => -1
  */
-int ucreate_host(const char* PORT)
+int uring_usend(struct uring *u, struct uring_op *op, int sockfd, struct addrinfo *targetinfo, const char* data, const int DATA_SIZE)
 {
-	int retfd;
-	struct addrinfo hints, *servinfo;
-	
-	memset(&hints, 0, sizeof hints);
-	hints.ai_family = AF_UNSPEC;
-	hints.ai_socktype = SOCK_DGRAM;
-	hints.ai_flags = AI_PASSIVE;
+	struct io_uring_sqe *sqe;
 	
-	if(getaddrinfo(NULL, PORT, &hints, &servinfo) != 0)
+	if((sqe = uring__get_sqe(u, op, URING_OP_USEND, sockfd)) == NULL)
 	{
 		return -1;
 	}
+	op->iov.iov_base = (void*)data;
+	op->iov.iov_len = DATA_SIZE;
+	memset(&op->msg, 0, sizeof op->msg);
+	op->msg.msg_name = targetinfo->ai_addr;
+	op->msg.msg_namelen = targetinfo->ai_addrlen;
+	op->msg.msg_iov = &op->iov;
+	op->msg.msg_iovlen = 1;
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->addr = (uint64_t)(uintptr_t)&op->msg;
+	sqe->len = 1;
+	return 0;
+}
+
+static void uring__complete(struct uring *u, struct io_uring_cqe *cqe)
+{
+	struct uring_op *op = (struct uring_op*)(uintptr_t)cqe->user_data;
+	int res = cqe->res;
 	
-	if((retfd = socket(servinfo->ai_family, servinfo->ai_socktype, servinfo->ai_protocol)) == -1)
+	if(!(cqe->flags & IORING_CQE_F_MORE)) op->armed = 0;
+	
+	switch(op->type)
 	{
-		return -2;
+		case URING_OP_TSEND:
+			if(res < 0)
+			{
+				op->cb(u, op, TSEND_ERR_SEND, NULL);
+				break;
+			}
+			op->bytes_done += res;
+			if(op->bytes_done < op->bytes_size)
+			{
+				if(uring__queue_send(u, op) < 0) op->cb(u, op, TSEND_ERR_SEND, NULL);
+				break;
+			}
+			op->cb(u, op, op->bytes_done, NULL);
+			break;
+		case URING_OP_TRECV:
+			op->cb(u, op, (res < 1) ? TRECV_ERR_NODATA : res, (res < 1) ? NULL : op->bytes);
+			break;
+		case URING_OP_TRECV_MULTI:
+			if(res < 1 || !(cqe->flags & IORING_CQE_F_BUFFER))
+			{
+				if(cqe->flags & IORING_CQE_F_BUFFER) uring__recycle_buffer(u, (unsigned short)(cqe->flags >> IORING_CQE_BUFFER_SHIFT));
+				op->cb(u, op, TRECV_ERR_NODATA, NULL);
+				break;
+			}
+			op->cb(u, op, res, u->br_bufs + (size_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT) * u->br_buf_size);
+			uring__recycle_buffer(u, (unsigned short)(cqe->flags >> IORING_CQE_BUFFER_SHIFT));
+			break;
+		case URING_OP_ACCEPT_MULTI:
+			op->cb(u, op, (res < 0) ? TLISTEN_ACCEPT_ERR_ACCEPT : res, NULL);
+			break;
+		case URING_OP_USEND:
+			op->cb(u, op, (res < 0) ? USEND_ERR_SEND : res, NULL);
+			break;
 	}
+}
+
+
+#define URING_RUN_ONCE_ERRS (1)
+#define URING_RUN_ONCE_ERR_ENTER (-1)
+#define URING_RUN_ONCE_ERR_ENTER_STR "Unable to submit requests or wait for completions"
+
+#define URING_RUN_ONCE_ERR__STR(err) ((err == URING_RUN_ONCE_ERR_ENTER) ? URING_RUN_ONCE_ERR_ENTER_STR : "")
+
+/**
+ * Submits all queued requests and dispatches completions to their callbacks, using one syscall unless the kernel overflowed
+ * the completion ring: then every time the ring was drained, another syscall flushes held back completions into it.
+ * All of them are counted in [stat_enter].
+ * Requests queued by callbacks are submitted with the next call.
+ * 
+ * struct uring *u: Ring to run
+ * int wait:        1 to block until at least one completion arrived, 0 to only reap what is already there
+ * 
+ * return:          Returns the number of completions dispatched and error code upon failure
+ * 
+ * {error codes}:
+ *  Unable to submit requests or wait for completions => -1
+ */
+int uring_run_once(struct uring *u, int wait)
+{
+	unsigned int head, tail;
+	int dispatched = 0;
+	// Completions which didn't fit into a full completion queue wait in the kernel until it is entered with GETEVENTS
+	int overflow = (__atomic_load_n(u->sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW) != 0;
 	
-	int yes = 1;
-	if (setsockopt(retfd,SOL_SOCKET,SO_REUSEADDR,&yes,sizeof(int)) == -1)
+	if(u->sq_pending || wait || overflow)
 	{
-		return -4;
+		int ret;
+		
+		__atomic_store_n(u->sq_tail, u->sq_local_tail, __ATOMIC_RELEASE);
+		if((ret = uring__enter(u, u->sq_pending, wait ? 1 : 0, (wait || overflow) ? IORING_ENTER_GETEVENTS : 0)) < 0)
+		{
+			return -1;
+		}
+		u->sq_pending -= ret;
 	}
 	
-	if(bind(retfd, servinfo->ai_addr, servinfo->ai_addrlen) == -1)
+	head = *u->cq_head;
+	tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+	while(head != tail)
 	{
-		close(retfd);
-		return -3;
+		struct io_uring_cqe cqe = u->cqes[head & *u->cq_mask];
+		
+		// Release the slot before dispatching, the callback might queue new requests
+		head++;
+		__atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+		uring__complete(u, &cqe);
+		dispatched++;
+		if(head == tail)
+		{
+			// Overflowed while reaping: flush the rest into the now empty queue
+			if((__atomic_load_n(u->sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW) && uring__enter(u, 0, 0, IORING_ENTER_GETEVENTS) < 0)
+			{
+				break;
+			}
+			tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+		}
 	}
-	
-	freeaddrinfo(servinfo);
-	
-	return retfd;
+	u->stat_completions += dispatched;
+	return dispatched;
 }
 
+#define URING_DESTROY_ERRS (0)
+#define URING_DESTROY_ERR__STR(err) ""
 
-/*
-void tpollfds(int *fds, int biggest_fd)
+/**
+ * Tears down the ring. Pending requests are cancelled by the kernel.
+ * 
+ */
+void uring_destroy(struct uring *u)
 {
-	fds = select(biggest_fd+1, &fds, NULL, NULL, 0);
+	close(u->ring_fd);
+	munmap(u->sqes, u->sqes_size);
+	if(u->cq_ptr != u->sq_ptr) munmap(u->cq_ptr, u->cq_ptr_size);
+	munmap(u->sq_ptr, u->sq_ptr_size);
+	if(u->br != NULL)
+	{
+		munmap(u->br, u->br_ring_size);
+		free(u->br_bufs);
+		u->br = NULL;
+	}
 }
-*/
+
+#endif /* NETLIB_IO_URING */
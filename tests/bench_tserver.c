@@ -0,0 +1,91 @@
+/*
+Server scaling: loopback ping-pong clients against 1, 2, 4, ... workers up to the number of online CPUs.
+Prints requests per second for every worker count, which should grow with the workers until the CPUs are saturated.
+*/
+#include "test.h"
+
+#define CLIENTS_PER_WORKER (4)
+#define SECONDS (2)
+#define MESSAGE_SIZE (64)
+
+struct client
+{
+	char *port;
+	volatile int *stop;
+	unsigned long requests;
+};
+
+static void on_data(struct tserver_conn *c, char *data, int size, void *arg)
+{
+	(void)arg;
+	if(tsend(c->fd, data, size) != 0) tserver_close(c);
+}
+
+static void *client(void *arg)
+{
+	struct client *cl = (struct client*)arg;
+	char buf[MESSAGE_SIZE];
+	int fd;
+	
+	CHECK((fd = tconnect("127.0.0.1", cl->port)) >= 0);
+	memset(buf, 'p', sizeof buf);
+	while(!__atomic_load_n(cl->stop, __ATOMIC_RELAXED))
+	{
+		CHECK(tsend(fd, buf, sizeof buf) == 0);
+		CHECK(trecv_exact(fd, buf, sizeof buf) == 0);
+		cl->requests++;
+	}
+	close(fd);
+	return NULL;
+}
+
+static double run(int workers)
+{
+	struct tserver_handler h;
+	struct tserver srv;
+	struct client *clients;
+	pthread_t *threads;
+	volatile int stop = 0;
+	unsigned long total = 0;
+	char port[6];
+	int count = workers * CLIENTS_PER_WORKER, i;
+	
+	memset(&h, 0, sizeof h);
+	h.on_data = on_data;
+	test_free_port(port);
+	CHECK(tserver_start(&srv, port, workers, &h, 4096) == 0);
+	CHECK((clients = (struct client*)calloc(count, sizeof *clients)) != NULL);
+	CHECK((threads = (pthread_t*)malloc(count * sizeof *threads)) != NULL);
+	for(i = 0; i < count; i++)
+	{
+		clients[i].port = port;
+		clients[i].stop = &stop;
+		CHECK(pthread_create(&threads[i], NULL, client, &clients[i]) == 0);
+	}
+	sleep(SECONDS);
+	__atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+	for(i = 0; i < count; i++)
+	{
+		pthread_join(threads[i], NULL);
+		total += clients[i].requests;
+	}
+	tserver_stop(&srv);
+	free(threads);
+	free(clients);
+	return (double)total / SECONDS;
+}
+
+int main(void)
+{
+	int cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	int workers;
+	
+	if(cpus < 1) cpus = 1;
+	for(workers = 1; ; workers *= 2)
+	{
+		if(workers > cpus) workers = cpus;
+		printf("bench_tserver: %d workers, %d clients: %.0f requests/s\n", workers, workers * CLIENTS_PER_WORKER, run(workers));
+		if(workers == cpus) break;
+	}
+	return 0;
+}
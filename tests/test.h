@@ -0,0 +1,53 @@
+/*
+Shared helpers of the loopback tests. Every test is a single program returning 0 upon success,
+built and run under AddressSanitizer by "make test".
+*/
+#ifndef NETLIB_TEST_H
+#define NETLIB_TEST_H
+
+#include "../netlib.h"
+#include <stdio.h>
+
+#define CHECK(cond) do { if(!(cond)) { fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); exit(1); } } while(0)
+
+/* Finds a free loopback TCP port and writes it to [port] (at least 6 bytes) */
+static inline void test_free_port(char *port)
+{
+	struct sockaddr_in addr;
+	socklen_t addr_size = sizeof addr;
+	int fd;
+	
+	CHECK((fd = socket(AF_INET, SOCK_STREAM, 0)) >= 0);
+	memset(&addr, 0, sizeof addr);
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	CHECK(bind(fd, (struct sockaddr*)&addr, sizeof addr) == 0);
+	CHECK(getsockname(fd, (struct sockaddr*)&addr, &addr_size) == 0);
+	snprintf(port, 6, "%u", (unsigned int)ntohs(addr.sin_port));
+	close(fd);
+}
+
+/* Connects a loopback TCP pair: [fds][0] is the client, [fds][1] the accepted server side */
+static inline void test_tcp_pair(int fds[2])
+{
+	char port[6];
+	int host;
+	
+	test_free_port(port);
+	CHECK((host = tcreate_host(port)) >= 0);
+	CHECK(listen(host, 1) == 0);
+	CHECK((fds[0] = tconnect("127.0.0.1", port)) >= 0);
+	CHECK((fds[1] = accept(host, NULL, NULL)) >= 0);
+	close(host);
+}
+
+/* Waits up to 10 seconds for [*value] to reach [target], which other threads increment atomically */
+static inline int test_wait_for(int *value, int target)
+{
+	int i;
+	
+	for(i = 0; i < 10000 && __atomic_load_n(value, __ATOMIC_ACQUIRE) < target; i++) usleep(1000);
+	return __atomic_load_n(value, __ATOMIC_ACQUIRE) >= target;
+}
+
+#endif /* NETLIB_TEST_H */
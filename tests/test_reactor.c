@@ -0,0 +1,110 @@
+/*
+Reactor: readiness callbacks, timers, cross-thread posts and rejected registrations.
+*/
+#include "test.h"
+
+static int received, fired, cancelled_fired, posted;
+
+static void on_readable(struct reactor *r, int fd, unsigned int events, void *arg)
+{
+	char buf[64];
+	ssize_t n;
+	
+	(void)r;
+	(void)arg;
+	CHECK(events & EPOLLIN);
+	while((n = recv(fd, buf, sizeof buf, MSG_DONTWAIT)) > 0) received += (int)n;
+}
+
+static void on_timer(struct reactor *r, int fd, unsigned int events, void *arg)
+{
+	(void)fd;
+	(void)events;
+	(void)arg;
+	fired++;
+	reactor_stop(r);
+}
+
+static void on_cancelled(struct reactor *r, int fd, unsigned int events, void *arg)
+{
+	(void)r;
+	(void)fd;
+	(void)events;
+	(void)arg;
+	cancelled_fired++;
+}
+
+struct post
+{
+	struct reactor_task t;
+	struct reactor *r;
+	int last;
+};
+
+#define POSTS (1000)
+
+static struct post posts[POSTS];
+
+static void on_post(struct reactor_task *t)
+{
+	struct post *p = (struct post*)t;
+	
+	CHECK(p == &posts[posted]);
+	posted++;
+	if(p->last) reactor_stop(p->r);
+}
+
+static void *poster(void *arg)
+{
+	struct reactor *r = (struct reactor*)arg;
+	int i;
+	
+	for(i = 0; i < POSTS; i++)
+	{
+		posts[i].t.fn = on_post;
+		posts[i].r = r;
+		posts[i].last = (i == POSTS - 1);
+		CHECK(reactor_post(r, &posts[i].t) == 0);
+	}
+	return NULL;
+}
+
+int main(void)
+{
+	struct reactor r;
+	pthread_t thread;
+	int fds[2], tfd;
+	
+	CHECK(reactor_create(&r) == 0);
+	CHECK(reactor_add(&r, -1, EPOLLIN, on_readable, NULL) == -2);
+	
+	// Readiness
+	test_tcp_pair(fds);
+	CHECK(set_nonblock(fds[1], 1) == 0);
+	CHECK(reactor_add(&r, fds[1], EPOLLIN, on_readable, NULL) == 0);
+	CHECK(reactor_add(&r, fds[1], EPOLLIN, on_readable, NULL) < 0);
+	CHECK(tsend(fds[0], (char*)"hello", 5) == 0);
+	while(received < 5) CHECK(reactor_run_once(&r, 1000) > 0);
+	CHECK(reactor_del(&r, fds[1]) == 0);
+	CHECK(reactor_del(&r, fds[1]) == -1);
+	
+	// Timers: a cancelled one never fires
+	CHECK((tfd = reactor_add_timer(&r, 1000, on_cancelled, NULL)) >= 0);
+	CHECK(reactor_del_timer(&r, tfd) == 0);
+	CHECK(reactor_add_timer(&r, 20000, on_timer, NULL) >= 0);
+	CHECK(reactor_run(&r) == 0);
+	CHECK(fired == 1 && cancelled_fired == 0);
+	
+	// Posts from another thread run in order on the reactor thread
+	CHECK(pthread_create(&thread, NULL, poster, &r) == 0);
+	CHECK(reactor_run(&r) == 0);
+	pthread_join(thread, NULL);
+	CHECK(posted == POSTS);
+	
+	close(fds[0]);
+	close(fds[1]);
+	reactor_destroy(&r);
+	CHECK(r.epfd == -1 && r.slots == NULL);
+	printf("test_reactor: ok\n");
+	return 0;
+}
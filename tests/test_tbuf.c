@@ -0,0 +1,86 @@
+/*
+Buffer pool: references, chunk reuse and alignment, releases on other threads and more pools than a thread caches.
+*/
+#include "test.h"
+
+#define POOLS (TBUF_THREAD_POOLS + 4)
+#define SLICES (1000)
+
+static struct tbuf_slice slices[SLICES];
+
+static void *releaser(void *arg)
+{
+	int i;
+	
+	(void)arg;
+	for(i = 0; i < SLICES; i++) tbuf_release(&slices[i]);
+	return NULL;
+}
+
+int main(void)
+{
+	struct tbuf_pool pool, pools[POOLS];
+	struct tbuf_slice s, part;
+	pthread_t thread;
+	char *data;
+	int i, round;
+	
+	CHECK(tbuf_pool_create(&pool, 0, 16) == -1);
+	CHECK(tbuf_pool_create(&pool, 100, 16) == 0);
+	
+	// References keep the chunk alive, the last release makes it available again
+	CHECK(tbuf_alloc(&pool, &s) == 0);
+	CHECK(s.size == 100 && ((uintptr_t)s.data & 63) == 0);
+	memset(s.data, 'x', s.size);
+	data = s.data;
+	CHECK(tbuf_ref(&part, &s, 90, 11) == -1);
+	CHECK(tbuf_ref(&part, &s, 10, 20) == 0);
+	CHECK(part.data == s.data + 10 && part.size == 20);
+	tbuf_release(&s);
+	CHECK(s.chunk == NULL);
+	CHECK(part.data[0] == 'x');
+	tbuf_release(&part);
+	tbuf_release(&part);
+	CHECK(tbuf_alloc(&pool, &s) == 0);
+	CHECK(s.data == data);
+	tbuf_release(&s);
+	
+	// Chunks allocated here and released by another thread, more than a thread caches
+	for(i = 0; i < SLICES; i++)
+	{
+		CHECK(tbuf_alloc(&pool, &slices[i]) == 0);
+		CHECK(((uintptr_t)slices[i].data & 63) == 0);
+		memset(slices[i].data, i, slices[i].size);
+	}
+	CHECK(pthread_create(&thread, NULL, releaser, NULL) == 0);
+	pthread_join(thread, NULL);
+	CHECK(pool.free != NULL);
+	for(i = 0; i < SLICES; i++) CHECK(tbuf_alloc(&pool, &slices[i]) == 0);
+	for(i = 0; i < SLICES; i++) tbuf_release(&slices[i]);
+	tbuf_pool_destroy(&pool);
+	
+	// Cycling through more pools than the thread caches hands evicted chunks back to their pool
+	for(i = 0; i < POOLS; i++) CHECK(tbuf_pool_create(&pools[i], 64 * (i + 1), 4) == 0);
+	for(round = 0; round < 3; round++)
+	{
+		for(i = 0; i < POOLS; i++)
+		{
+			CHECK(tbuf_alloc(&pools[i], &s) == 0);
+			CHECK(s.size == 64 * (i + 1) && s.chunk->pool == &pools[i]);
+			memset(s.data, i, s.size);
+			tbuf_release(&s);
+		}
+	}
+	for(i = 0; i < POOLS - TBUF_THREAD_POOLS; i++) CHECK(pools[i].free != NULL);
+	// Destroying a pool whose chunks the thread still caches
+	tbuf_pool_destroy(&pools[POOLS - 1]);
+	for(i = 0; i < POOLS - 1; i++)
+	{
+		CHECK(tbuf_alloc(&pools[i], &s) == 0);
+		tbuf_release(&s);
+		tbuf_pool_destroy(&pools[i]);
+	}
+	
+	printf("test_tbuf: ok\n");
+	return 0;
+}
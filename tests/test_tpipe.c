@@ -0,0 +1,117 @@
+/*
+Pipelining: responses matched to requests in order, requests bigger than the socket buffers against a peer
+which only reads once it wrote its response, and errors once the peer is gone.
+*/
+#include "test.h"
+
+#define SMALL_REQUESTS (1000)
+#define BIG_REQUESTS (16)
+#define BIG_SIZE (1 << 20)
+
+struct echo
+{
+	int fd;
+	int count;
+	int size;
+};
+
+/* Every message is [size] bytes long, the echo peer sends each one back before reading the next */
+static int frame_size(const char *data, int size, void *arg)
+{
+	int expected = *(int*)arg;
+	
+	(void)data;
+	return (size >= expected) ? expected : 0;
+}
+
+static void *echo(void *arg)
+{
+	struct echo *e = (struct echo*)arg;
+	char *buf = (char*)malloc(e->size);
+	int i;
+	
+	CHECK(buf != NULL);
+	for(i = 0; i < e->count; i++)
+	{
+		CHECK(trecv_exact(e->fd, buf, e->size) == 0);
+		CHECK(tsend(e->fd, buf, e->size) == 0);
+	}
+	free(buf);
+	return NULL;
+}
+
+static int done_count;
+
+static void on_done(struct tpipe_req *req, char *resp, int resp_size)
+{
+	CHECK(resp_size == req->bytes_size && memcmp(resp, req->bytes, resp_size) == 0);
+	CHECK((intptr_t)req->user == done_count);
+	done_count++;
+}
+
+static void run(int count, int size, int window, int sockbuf)
+{
+	struct tpipe_req *reqs = (struct tpipe_req*)calloc(count, sizeof *reqs);
+	struct tpipe p;
+	struct echo e;
+	pthread_t thread;
+	int fds[2], i;
+	
+	CHECK(reqs != NULL);
+	test_tcp_pair(fds);
+	for(i = 0; i < 2 && sockbuf > 0; i++)
+	{
+		CHECK(setsockopt(fds[i], SOL_SOCKET, SO_SNDBUF, &sockbuf, sizeof sockbuf) == 0);
+		CHECK(setsockopt(fds[i], SOL_SOCKET, SO_RCVBUF, &sockbuf, sizeof sockbuf) == 0);
+	}
+	e.fd = fds[1];
+	e.count = count;
+	e.size = size;
+	CHECK(pthread_create(&thread, NULL, echo, &e) == 0);
+	CHECK(tpipe_create(&p, fds[0], window, 2 * size, frame_size, &e.size) == 0);
+	done_count = 0;
+	for(i = 0; i < count; i++)
+	{
+		CHECK((reqs[i].bytes = (char*)malloc(size)) != NULL);
+		memset(reqs[i].bytes, 'a' + i % 26, size);
+		reqs[i].bytes_size = size;
+		reqs[i].done = on_done;
+		reqs[i].user = (void*)(intptr_t)i;
+		CHECK(tpipe_submit(&p, &reqs[i]) == 0);
+	}
+	CHECK(tpipe_flush(&p) == 0);
+	CHECK(done_count == count);
+	pthread_join(thread, NULL);
+	tpipe_destroy(&p);
+	close(fds[0]);
+	close(fds[1]);
+	for(i = 0; i < count; i++) free(reqs[i].bytes);
+	free(reqs);
+}
+
+int main(void)
+{
+	struct tpipe_req req;
+	struct tpipe p;
+	int fds[2], size = 4, ret;
+	
+	run(SMALL_REQUESTS, 32, 64, 0);
+	// Requests far bigger than the socket buffers would deadlock with a blocking send: both sides wait for the other to read
+	run(BIG_REQUESTS, BIG_SIZE, BIG_REQUESTS, 65536);
+	
+	// The peer disconnects with a request in flight
+	test_tcp_pair(fds);
+	CHECK(tpipe_create(&p, fds[0], 4, 64, frame_size, &size) == 0);
+	memset(&req, 0, sizeof req);
+	req.bytes = (char*)"ping";
+	req.bytes_size = 4;
+	CHECK(tpipe_submit(&p, &req) == 0);
+	close(fds[1]);
+	ret = tpipe_flush(&p);
+	CHECK(ret == TPIPE_FLUSH_ERR_NODATA || ret == TPIPE_FLUSH_ERR_RECV);
+	tpipe_destroy(&p);
+	close(fds[0]);
+	
+	printf("test_tpipe: ok\n");
+	return 0;
+}
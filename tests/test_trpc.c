@@ -0,0 +1,99 @@
+/*
+Multiplexed RPC: concurrent calls answered by the peer channel, calls failed by a channel which stops and by one
+which can no longer send, with a status telling channel failures apart from TRPC_ERROR answers.
+*/
+#include "test.h"
+
+#define CALLS (2000)
+
+static int completed, failed, expected_status;
+
+static void on_request(struct trpc *c, uint32_t id, char *data, int size, void *arg)
+{
+	(void)arg;
+	CHECK(trpc_reply(c, id, 0, data, size) == 0);
+}
+
+static void on_done(struct trpc_call *call, int status, char *resp, int resp_size)
+{
+	if(status == 0)
+	{
+		CHECK(resp_size == call->req_size && memcmp(resp, call->req, resp_size) == 0);
+		__atomic_add_fetch(&completed, 1, __ATOMIC_ACQ_REL);
+	}
+	else
+	{
+		CHECK(status == expected_status);
+		__atomic_add_fetch(&failed, 1, __ATOMIC_ACQ_REL);
+	}
+	free(call);
+}
+
+static struct trpc_call *new_call(const char *req)
+{
+	struct trpc_call *call = (struct trpc_call*)calloc(1, sizeof *call);
+	
+	CHECK(call != NULL);
+	call->req = req;
+	call->req_size = (int)strlen(req);
+	call->done = on_done;
+	return call;
+}
+
+int main(void)
+{
+	struct trpc client, server;
+	int fds[2], i;
+	
+	// Calls answered by the peer
+	test_tcp_pair(fds);
+	CHECK(trpc_start(&client, fds[0], 4096, NULL, NULL) == 0);
+	CHECK(trpc_start(&server, fds[1], 4096, on_request, NULL) == 0);
+	for(i = 0; i < CALLS; i++)
+	{
+		CHECK(trpc_request(&client, new_call((i % 2) ? "ping" : "a longer request")) == 0);
+	}
+	CHECK(test_wait_for(&completed, CALLS));
+	trpc_stop(&client);
+	trpc_stop(&server);
+	close(fds[0]);
+	close(fds[1]);
+	CHECK(failed == 0);
+	
+	// Calls the peer never answers are failed exactly once by trpc_stop
+	expected_status = -3;
+	test_tcp_pair(fds);
+	CHECK(trpc_start(&client, fds[0], 4096, NULL, NULL) == 0);
+	for(i = 0; i < CALLS; i++)
+	{
+		CHECK(trpc_request(&client, new_call("never answered")) == 0);
+	}
+	trpc_stop(&client);
+	close(fds[0]);
+	close(fds[1]);
+	CHECK(failed == CALLS && completed == CALLS);
+	
+	// A channel which can no longer send fails its calls with a status below -1, unlike TRPC_ERROR answers
+	expected_status = -4;
+	test_tcp_pair(fds);
+	CHECK(shutdown(fds[0], SHUT_WR) == 0);
+	CHECK(trpc_start(&client, fds[0], 4096, NULL, NULL) == 0);
+	for(i = 0; i < CALLS; i++)
+	{
+		struct trpc_call *call = new_call("never sent");
+		
+		if(trpc_request(&client, call) != 0)
+		{
+			free(call);
+			break;
+		}
+	}
+	CHECK(test_wait_for(&failed, CALLS + i));
+	trpc_stop(&client);
+	close(fds[0]);
+	close(fds[1]);
+	CHECK(failed == CALLS + i && completed == CALLS);
+	
+	printf("test_trpc: ok\n");
+	return 0;
+}
@@ -0,0 +1,85 @@
+/*
+Server: repeated start/stop, echo over concurrent connections and handler calls with the handler's argument.
+*/
+#include "test.h"
+
+#define ROUNDS (3)
+#define CONNS (16)
+#define MESSAGES (100)
+
+struct counts
+{
+	int accepted;
+	int closed;
+};
+
+static void on_accept(struct tserver_conn *c, void *arg)
+{
+	(void)c;
+	__atomic_add_fetch(&((struct counts*)arg)->accepted, 1, __ATOMIC_ACQ_REL);
+}
+
+static void on_data(struct tserver_conn *c, char *data, int size, void *arg)
+{
+	CHECK(arg != NULL);
+	if(tsend(c->fd, data, size) != 0) tserver_close(c);
+}
+
+static void on_close(struct tserver_conn *c, void *arg)
+{
+	(void)c;
+	__atomic_add_fetch(&((struct counts*)arg)->closed, 1, __ATOMIC_ACQ_REL);
+}
+
+int main(void)
+{
+	struct counts counts;
+	struct tserver_handler h;
+	struct tserver srv;
+	char port[6], buf[16];
+	int fds[CONNS], round, i, j;
+	
+	h.on_accept = on_accept;
+	h.on_data = on_data;
+	h.on_close = on_close;
+	h.arg = &counts;
+	for(round = 0; round < ROUNDS; round++)
+	{
+		memset(&counts, 0, sizeof counts);
+		test_free_port(port);
+		CHECK(tserver_start(&srv, port, 2, &h, 4096) == 0);
+		CHECK(srv.count == 2);
+		for(i = 0; i < CONNS; i++) CHECK((fds[i] = tconnect("127.0.0.1", port)) >= 0);
+		for(j = 0; j < MESSAGES; j++)
+		{
+			for(i = 0; i < CONNS; i++)
+			{
+				snprintf(buf, sizeof buf, "%04d:%04d", i, j);
+				CHECK(tsend(fds[i], buf, 9) == 0);
+			}
+			for(i = 0; i < CONNS; i++)
+			{
+				char expected[16];
+	
+				snprintf(expected, sizeof expected, "%04d:%04d", i, j);
+				CHECK(trecv_exact(fds[i], buf, 9) == 0);
+				CHECK(memcmp(buf, expected, 9) == 0);
+			}
+		}
+		CHECK(test_wait_for(&counts.accepted, CONNS) && counts.accepted == CONNS);
+	
+		// Half of the connections are closed by their peer, the rest by tserver_stop
+		for(i = 0; i < CONNS / 2; i++) close(fds[i]);
+		CHECK(test_wait_for(&counts.closed, CONNS / 2));
+		tserver_stop(&srv);
+		CHECK(counts.closed == CONNS && srv.workers == NULL);
+		for(i = CONNS / 2; i < CONNS; i++)
+		{
+			CHECK(recv(fds[i], buf, sizeof buf, 0) == 0);
+			close(fds[i]);
+		}
+	}
+	
+	printf("test_tserver: ok\n");
+	return 0;
+}